@@ -0,0 +1,521 @@
+#ifndef LOG_SCHEMA_H
+#define LOG_SCHEMA_H
+
+/*
+ * Log block types, expanded from the schema in log_schema_def.h.
+ *
+ * For every block X in LOG_SCHEMA_BLOCKS this provides:
+ *  - log_block_data_X_t:  packed data struct (what follows the header)
+ *  - log_block_X_t:       packed header + data, as sent on the wire
+ * and, for C++, log_block_traits<log_block_data_X_t> (log type, sizes, a
+ * constexpr field table with name, offset, size and kind per field, and
+ * per field code expanded from the schema) together with the templated
+ * codecs below.
+ *
+ * Everything is packed and little endian, so encoding and decoding a block
+ * is a size check and a memcpy. Filtered blocks (see LOG_SCHEMA_FILTERED)
+ * carry a field mask and only the selected fields of their full block, each
+ * one a fixed size copy.
+ */
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "stddef.h"
+#include "string.h"
+
+#include "log_schema_def.h"
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+    #error "Log blocks are encoded as little endian structs"
+#endif
+
+
+typedef enum
+{
+#define LOG_SCHEMA_X(block, log_type, value) log_type = value,
+    LOG_SCHEMA_BLOCKS(LOG_SCHEMA_X)
+#undef LOG_SCHEMA_X
+} log_type_t;
+
+// Named field values, e.g. log_summary_stat_t and log_link_mode_t
+enum
+{
+#define LOG_SCHEMA_E(enum_type, name, value) name = value,
+    LOG_SCHEMA_ENUMS(LOG_SCHEMA_E)
+#undef LOG_SCHEMA_E
+};
+
+// Field kinds are named after the C type so that they can be token pasted
+typedef enum
+{
+    LOG_FIELD_KIND_bool,
+    LOG_FIELD_KIND_uint8_t,
+    LOG_FIELD_KIND_int8_t,
+    LOG_FIELD_KIND_uint16_t,
+    LOG_FIELD_KIND_int16_t,
+    LOG_FIELD_KIND_uint32_t,
+    LOG_FIELD_KIND_int32_t,
+    LOG_FIELD_KIND_uint64_t,
+    LOG_FIELD_KIND_int64_t,
+    LOG_FIELD_KIND_float,
+    LOG_FIELD_KIND_double
+} log_field_kind_t;
+
+typedef struct
+{
+    const char*      name;
+    uint8_t          offset;
+    uint8_t          size;
+    log_field_kind_t kind;
+} log_field_t;
+
+
+// -- Structs -- //
+#define LOG_SCHEMA_STRUCT_FIELD(ctype, name) ctype name;
+
+typedef struct
+{
+    LOG_SCHEMA_FIELDS_header(LOG_SCHEMA_STRUCT_FIELD)
+}__attribute__((packed)) log_block_header_t;
+
+#define LOG_SCHEMA_X(block, log_type, value)              \
+    typedef struct                                        \
+    {                                                     \
+        LOG_SCHEMA_FIELDS_##block(LOG_SCHEMA_STRUCT_FIELD) \
+    }__attribute__((packed)) log_block_data_##block##_t;  \
+                                                          \
+    typedef struct                                        \
+    {                                                     \
+        log_block_header_t          header;               \
+        log_block_data_##block##_t  data;                 \
+    }__attribute__((packed)) log_block_##block##_t;
+LOG_SCHEMA_BLOCKS(LOG_SCHEMA_X)
+#undef LOG_SCHEMA_X
+
+
+/*
+ * Returns the size of the data following the header for the given log type,
+ * or 0 if the type is unknown.
+ */
+static inline size_t log_block_data_size(const uint8_t type)
+{
+    switch (type)
+    {
+#define LOG_SCHEMA_X(block, log_type, value) \
+        case log_type: return sizeof(log_block_data_##block##_t);
+        LOG_SCHEMA_BLOCKS(LOG_SCHEMA_X)
+#undef LOG_SCHEMA_X
+    }
+    return 0;
+}
+
+/*
+ * Returns the name of the block for the given log type, or NULL if the
+ * type is unknown.
+ */
+static inline const char* log_block_name(const uint8_t type)
+{
+    switch (type)
+    {
+#define LOG_SCHEMA_X(block, log_type, value) \
+        case log_type: return #block;
+        LOG_SCHEMA_BLOCKS(LOG_SCHEMA_X)
+#undef LOG_SCHEMA_X
+    }
+    return NULL;
+}
+
+/*
+ * log_block_<full>_filtered_size(field_mask): size of the fields of a full
+ * block selected by field_mask, i.e. what follows its filtered block.
+ */
+#define LOG_SCHEMA_FILTERED_SIZE(ctype, name)             \
+    size += (field_mask & (1ULL << i)) ? sizeof(ctype) : 0; \
+    i++;
+#define LOG_SCHEMA_FX(block, log_type, full)                                         \
+    static inline size_t log_block_##full##_filtered_size(const uint64_t field_mask) \
+    {                                                                                \
+        size_t size = 0;                                                             \
+        unsigned i = 0;                                                              \
+        LOG_SCHEMA_FIELDS_##full(LOG_SCHEMA_FILTERED_SIZE)                           \
+        return size;                                                                 \
+    }
+LOG_SCHEMA_FILTERED(LOG_SCHEMA_FX)
+#undef LOG_SCHEMA_FX
+
+/*
+ * Returns the size of the data following the header of an encoded block:
+ * log_block_data_size(), plus the selected fields for a filtered block.
+ * data must hold at least log_block_data_size(type) bytes.
+ * Returns 0 if the type is unknown.
+ */
+static inline size_t log_block_wire_data_size(const uint8_t type, const uint8_t* data)
+{
+    switch (type)
+    {
+#define LOG_SCHEMA_FX(block, log_type, full)                                      \
+        case log_type:                                                           \
+        {                                                                        \
+            uint64_t field_mask;                                                 \
+            memcpy(&field_mask, data, sizeof(field_mask));                       \
+            return sizeof(log_block_data_##block##_t) + log_block_##full##_filtered_size(field_mask); \
+        }
+        LOG_SCHEMA_FILTERED(LOG_SCHEMA_FX)
+#undef LOG_SCHEMA_FX
+    }
+    return log_block_data_size(type);
+}
+
+
+#ifdef __cplusplus
+
+// -- Compile time layout -- //
+#define LOG_SCHEMA_FIELD_ENTRY(ctype, name) \
+    { #name, offsetof(struct_t, name), sizeof(ctype), LOG_FIELD_KIND_##ctype },
+#define LOG_SCHEMA_FIELD_SIZE(ctype, name) + sizeof(ctype)
+#define LOG_SCHEMA_FIELD_INDEX(ctype, name) name,
+#define LOG_SCHEMA_FIELD_VISIT(ctype, name) visitor(field::name, #name, data.name);
+#define LOG_SCHEMA_FIELD_COMBINE(ctype, name) data.name = combiner(field::name, data.name, other.name);
+#define LOG_SCHEMA_FIELD_FILTER(ctype, name)                                   \
+    if (field_mask & (1ULL << field::name))                                    \
+    {                                                                          \
+        memcpy(&out[written], in + offsetof(struct_t, name), sizeof(ctype));   \
+        written += sizeof(ctype);                                              \
+    }
+#define LOG_SCHEMA_FIELD_FILTERED_SIZE(ctype, name) \
+    size += (field_mask & (1ULL << field::name)) ? sizeof(ctype) : 0;
+#define LOG_SCHEMA_FIELD_UNFILTER(ctype, name)                                 \
+    if (field_mask & (1ULL << field::name))                                    \
+    {                                                                          \
+        memcpy(out + offsetof(struct_t, name), &in[read], sizeof(ctype));      \
+        read += sizeof(ctype);                                                 \
+    }
+
+/*
+ * Field table of a packed schema struct: log_schema_fields<T>::fields[i]
+ * holds name, offset, size and kind of field i, and field::<name> is the
+ * index of a field.
+ *
+ * The per field code is expanded from the schema, so every field is handled
+ * with its own type, offset and size known at compile time:
+ *   visit(data, visitor)  Calls visitor(index, name, value) for each field,
+ *                         value is of the C type of the field
+ *   combine(data, other, combiner)
+ *                         Sets each field of data to combiner(index, field of
+ *                         data, field of other), e.g. to keep a running min
+ *   filter(), unfilter()  See log_block_filter() and log_block_unfilter()
+ *   filtered_size(mask)   Bytes written by filter() for the mask
+ */
+template <typename Struct>
+struct log_schema_fields;
+
+#define LOG_SCHEMA_FIELD_TABLE(struct_type, fields_macro)                               \
+    template <>                                                                         \
+    struct log_schema_fields<struct_type>                                               \
+    {                                                                                   \
+        typedef struct_type struct_t;                                                   \
+        struct field                                                                    \
+        {                                                                               \
+            enum : uint8_t { fields_macro(LOG_SCHEMA_FIELD_INDEX) };                    \
+        };                                                                              \
+        static constexpr log_field_t fields[] = { fields_macro(LOG_SCHEMA_FIELD_ENTRY) }; \
+        static constexpr size_t nbr_of_fields = sizeof(fields) / sizeof(fields[0]);     \
+                                                                                        \
+        template <typename Visitor>                                                     \
+        static inline void visit(const struct_t& data, Visitor&& visitor)               \
+        {                                                                               \
+            fields_macro(LOG_SCHEMA_FIELD_VISIT)                                        \
+        }                                                                               \
+                                                                                        \
+        template <typename Combiner>                                                    \
+        static inline void combine(struct_t& data, const struct_t& other, Combiner&& combiner) \
+        {                                                                               \
+            fields_macro(LOG_SCHEMA_FIELD_COMBINE)                                      \
+        }                                                                               \
+                                                                                        \
+        static inline size_t filter(const struct_t& data, const uint64_t field_mask, uint8_t* out) \
+        {                                                                               \
+            const uint8_t* in = (const uint8_t*) &data;                                 \
+            size_t written = 0;                                                         \
+            fields_macro(LOG_SCHEMA_FIELD_FILTER)                                       \
+            return written;                                                             \
+        }                                                                               \
+                                                                                        \
+        static inline size_t filtered_size(const uint64_t field_mask)                   \
+        {                                                                               \
+            size_t size = 0;                                                            \
+            fields_macro(LOG_SCHEMA_FIELD_FILTERED_SIZE)                                \
+            return size;                                                                \
+        }                                                                               \
+                                                                                        \
+        static inline size_t unfilter(const uint8_t* in, const uint64_t field_mask, struct_t* data) \
+        {                                                                               \
+            uint8_t* out = (uint8_t*) data;                                             \
+            size_t read = 0;                                                            \
+            fields_macro(LOG_SCHEMA_FIELD_UNFILTER)                                     \
+            return read;                                                                \
+        }                                                                               \
+    };                                                                                  \
+                                                                                        \
+    static_assert(sizeof(struct_type) == 0 fields_macro(LOG_SCHEMA_FIELD_SIZE),         \
+                  #struct_type " is not packed");                                       \
+    static_assert(log_schema_fields<struct_type>::fields[log_schema_fields<struct_type>::nbr_of_fields - 1].offset + \
+                  log_schema_fields<struct_type>::fields[log_schema_fields<struct_type>::nbr_of_fields - 1].size ==  \
+                  sizeof(struct_type),                                                  \
+                  #struct_type " field offsets do not cover the struct");
+
+LOG_SCHEMA_FIELD_TABLE(log_block_header_t, LOG_SCHEMA_FIELDS_header)
+
+/*
+ * Compile time description of a log block data struct.
+ */
+template <typename Block>
+struct log_block_traits;
+
+#define LOG_SCHEMA_X(block, log_type_value, value)                                      \
+    LOG_SCHEMA_FIELD_TABLE(log_block_data_##block##_t, LOG_SCHEMA_FIELDS_##block)       \
+                                                                                        \
+    template <>                                                                         \
+    struct log_block_traits<log_block_data_##block##_t>                                 \
+        : log_schema_fields<log_block_data_##block##_t>                                 \
+    {                                                                                   \
+        static constexpr log_type_t  log_type   = log_type_value;                       \
+        static constexpr const char* block_name = #block;                               \
+        static constexpr size_t      data_size  = sizeof(log_block_data_##block##_t);   \
+        static constexpr size_t      wire_size  = sizeof(log_block_##block##_t);        \
+        /* field_mask with every field set */                                           \
+        static constexpr uint64_t    all_fields = ~0ULL >> (64 - nbr_of_fields);         \
+    };                                                                                  \
+                                                                                        \
+    static_assert(sizeof(log_block_##block##_t) <= 0xFF,                                \
+                  "log_block_" #block "_t does not fit in one VSTP packet");            \
+    static_assert(log_block_traits<log_block_data_##block##_t>::nbr_of_fields <= 64,    \
+                  "Field masks are 64 bit");
+LOG_SCHEMA_BLOCKS(LOG_SCHEMA_X)
+#undef LOG_SCHEMA_X
+
+/*
+ * Filtered block of a full block, log_block_filtered<Full>::type, see
+ * LOG_SCHEMA_FILTERED.
+ */
+template <typename Block>
+struct log_block_filtered;
+
+#define LOG_SCHEMA_FX(block, log_type_value, full)                                      \
+    template <>                                                                         \
+    struct log_block_filtered<log_block_data_##full##_t>                                \
+    {                                                                                   \
+        typedef log_block_data_##block##_t type;                                        \
+    };                                                                                  \
+                                                                                        \
+    static_assert(log_block_traits<log_block_data_##block##_t>::log_type == log_type_value, \
+                  #block " is listed with the wrong log type");                         \
+    static_assert(sizeof(log_block_data_##block##_t) == sizeof(uint64_t),                \
+                  #block " must only have the field_mask field");                       \
+    static_assert(sizeof(log_block_##block##_t) + sizeof(log_block_data_##full##_t) <= 0xFF, \
+                  #block " of every field does not fit in one VSTP packet");
+LOG_SCHEMA_FILTERED(LOG_SCHEMA_FX)
+#undef LOG_SCHEMA_FX
+
+// The flight controller sends this header as '<BII'
+static_assert(sizeof(log_block_header_t) == 9, "Log block header layout changed");
+
+/*
+ * Returns the field table for the given log type and sets nbr_of_fields,
+ * or returns NULL if the type is unknown. For generic (e.g. text) decoding,
+ * use log_block_traits when the type is known at compile time.
+ */
+inline const log_field_t* log_block_fields(const uint8_t type, size_t* nbr_of_fields)
+{
+    switch (type)
+    {
+#define LOG_SCHEMA_X(block, log_type, value)                                              \
+        case log_type:                                                                   \
+            *nbr_of_fields = log_block_traits<log_block_data_##block##_t>::nbr_of_fields; \
+            return log_block_traits<log_block_data_##block##_t>::fields;
+        LOG_SCHEMA_BLOCKS(LOG_SCHEMA_X)
+#undef LOG_SCHEMA_X
+    }
+    *nbr_of_fields = 0;
+    return NULL;
+}
+
+
+// -- Codecs -- //
+
+/*
+ * Encodes header + data into out.
+ * Returns the number of bytes written, or 0 if out is too small.
+ */
+template <typename Block>
+inline size_t log_block_encode(uint8_t* out, const size_t out_size,
+                               const uint32_t timestamp, const uint32_t id,
+                               const Block& data)
+{
+    typedef log_block_traits<Block> traits;
+
+    if (out_size < traits::wire_size)
+    {
+        return 0;
+    }
+
+    log_block_header_t header;
+    header.type = traits::log_type;
+    header.timestamp = timestamp;
+    header.id = id;
+
+    memcpy(out, &header, sizeof(header));
+    memcpy(out + sizeof(header), &data, traits::data_size);
+    return traits::wire_size;
+}
+
+/*
+ * Decodes a complete block (header + data) from in.
+ * Returns false if the size or the type does not match Block.
+ */
+template <typename Block>
+inline bool log_block_decode(const uint8_t* in, const size_t in_size,
+                             log_block_header_t* header, Block* data)
+{
+    typedef log_block_traits<Block> traits;
+
+    if ((in_size != traits::wire_size) || (in[0] != traits::log_type))
+    {
+        return false;
+    }
+
+    memcpy(header, in, sizeof(*header));
+    memcpy(data, in + sizeof(*header), traits::data_size);
+    return true;
+}
+
+/*
+ * Copies the fields selected by field_mask (bit N = field index N) from
+ * data to out, back to back in schema order.
+ * Returns the number of bytes written, at most sizeof(Block).
+ */
+template <typename Block>
+inline size_t log_block_filter(const Block& data, const uint64_t field_mask, uint8_t* out)
+{
+    return log_block_traits<Block>::filter(data, field_mask, out);
+}
+
+/*
+ * Reads the fields selected by field_mask from in, as written by
+ * log_block_filter(), into data. The other fields are left as they are.
+ * Returns false if in_size does not match the mask.
+ */
+template <typename Block>
+inline bool log_block_unfilter(const uint8_t* in, const size_t in_size, const uint64_t field_mask, Block* data)
+{
+    typedef log_block_traits<Block> traits;
+
+    if (((field_mask & ~traits::all_fields) != 0) || (in_size != traits::filtered_size(field_mask)))
+    {
+        return false;
+    }
+
+    traits::unfilter(in, field_mask, data);
+    return true;
+}
+
+/*
+ * Encodes header + the fields of data selected by field_mask, as the
+ * filtered block of Block, into out.
+ * Returns the number of bytes written, or 0 if out is too small.
+ */
+template <typename Block>
+inline size_t log_block_encode_filtered(uint8_t* out, const size_t out_size,
+                                        const uint32_t timestamp, const uint32_t id,
+                                        const Block& data, const uint64_t field_mask)
+{
+    typedef typename log_block_filtered<Block>::type filtered_t;
+
+    if (out_size < log_block_traits<filtered_t>::wire_size + log_block_traits<Block>::data_size)
+    {
+        return 0;
+    }
+
+    filtered_t filtered;
+    filtered.field_mask = field_mask & log_block_traits<Block>::all_fields;
+    const size_t size = log_block_encode(out, out_size, timestamp, id, filtered);
+    return size + log_block_filter(data, filtered.field_mask, out + size);
+}
+
+/*
+ * Decodes the data of a block for log_block_dispatch(). Filtered blocks
+ * decode to their full block, with the fields they don't carry zeroed.
+ */
+template <typename Block>
+struct log_block_decoder
+{
+    template <typename Handler>
+    static inline bool decode(const uint8_t* data, const size_t size, Handler& handler)
+    {
+        if (size != sizeof(Block))
+        {
+            return false;
+        }
+
+        Block block;
+        memcpy(&block, data, sizeof(block));
+        handler(block, log_block_traits<Block>::all_fields);
+        return true;
+    }
+};
+
+#define LOG_SCHEMA_FX(block, log_type, full)                                            \
+    template <>                                                                         \
+    struct log_block_decoder<log_block_data_##block##_t>                                \
+    {                                                                                   \
+        template <typename Handler>                                                     \
+        static inline bool decode(const uint8_t* data, const size_t size, Handler& handler) \
+        {                                                                               \
+            log_block_data_##block##_t filtered;                                        \
+            if (size < sizeof(filtered))                                                \
+            {                                                                           \
+                return false;                                                           \
+            }                                                                           \
+            memcpy(&filtered, data, sizeof(filtered));                                  \
+                                                                                        \
+            log_block_data_##full##_t block;                                            \
+            memset(&block, 0, sizeof(block));                                           \
+            if (!log_block_unfilter(data + sizeof(filtered), size - sizeof(filtered),   \
+                                    filtered.field_mask, &block))                       \
+            {                                                                           \
+                return false;                                                           \
+            }                                                                           \
+            handler(block, (uint64_t) filtered.field_mask);                             \
+            return true;                                                                \
+        }                                                                               \
+    };
+LOG_SCHEMA_FILTERED(LOG_SCHEMA_FX)
+#undef LOG_SCHEMA_FX
+
+/*
+ * Calls handler(const Block& data, uint64_t field_mask) with the data of an
+ * encoded block as its typed struct, so the handler is instantiated per
+ * block type and can use log_block_traits<Block>::visit() instead of
+ * looking fields up at runtime. A filtered block is handed over as its full
+ * block, field_mask says which fields it carried. For other blocks every
+ * field is set.
+ * Returns false if the type is unknown or size does not match it.
+ */
+template <typename Handler>
+inline bool log_block_dispatch(const uint8_t type, const uint8_t* data, const size_t size, Handler&& handler)
+{
+    switch (type)
+    {
+#define LOG_SCHEMA_X(block, log_type, value)                                              \
+        case log_type:                                                                   \
+            return log_block_decoder<log_block_data_##block##_t>::decode(data, size, handler);
+        LOG_SCHEMA_BLOCKS(LOG_SCHEMA_X)
+#undef LOG_SCHEMA_X
+    }
+    return false;
+}
+
+#endif /* __cplusplus */
+
+
+#endif /* LOG_SCHEMA_H */
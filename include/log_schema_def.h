@@ -0,0 +1,172 @@
+#ifndef LOG_SCHEMA_DEF_H
+#define LOG_SCHEMA_DEF_H
+
+/*
+ * Telemetry log block schema.
+ *
+ * This is the single definition of every log block that travels through the
+ * telemetry node. The C/C++ types and codecs are expanded from it in
+ * log_schema.h, and the Python struct formats in tools/client/log_types.py
+ * are generated from it by tools/gen_log_types.py.
+ *
+ * Rules (the Python generator parses this file):
+ *  - One field per line, on the form F(<type>, <name>)
+ *  - Supported types: bool, uint8_t, int8_t, uint16_t, int16_t, uint32_t,
+ *    int32_t, uint64_t, int64_t, float, double
+ *  - All blocks are packed and little endian
+ *  - A block can include another block's fields by listing
+ *    LOG_SCHEMA_FIELDS_<other>(F) on its own line
+ *  - Named values of fields are listed in LOG_SCHEMA_ENUMS, one
+ *    E(<enum>, <name>, <value>) per line
+ *  - A filtered block has the single field F(uint64_t, field_mask) and is
+ *    listed in LOG_SCHEMA_FILTERED as well. On the wire it is followed by
+ *    the fields of its full block whose bit is set in field_mask, back to
+ *    back in schema order, so its size depends on the mask.
+ *
+ * After changing this file, regenerate the Python types with:
+ *   make -C tools/client log_types
+ */
+
+// Every block on the wire starts with this header
+#define LOG_SCHEMA_FIELDS_header(F) \
+    F(uint8_t,  type)               \
+    F(uint32_t, timestamp)          \
+    F(uint32_t, id)
+
+// X(<block name>, <log type>, <log type value>)
+#define LOG_SCHEMA_BLOCKS(X)                                     \
+    X(control_loop,          LOG_TYPE_PID,          0)           \
+    X(battery,               LOG_TYPE_BATTERY,      1)           \
+    X(control_loop_summary,  LOG_TYPE_PID_SUMMARY,  2)           \
+    X(link_mode,             LOG_TYPE_LINK_MODE,    3)           \
+    X(profile_phase,         LOG_TYPE_PROFILE,      4)           \
+    X(control_loop_filtered, LOG_TYPE_PID_FILTERED, 5)
+
+// FX(<filtered block>, <its log type>, <full block>)
+#define LOG_SCHEMA_FILTERED(FX)                                  \
+    FX(control_loop_filtered, LOG_TYPE_PID_FILTERED, control_loop)
+
+// E(<enum>, <name>, <value>)
+#define LOG_SCHEMA_ENUMS(E)                                   \
+    E(log_summary_stat_t,  LOG_SUMMARY_MIN,               0)  \
+    E(log_summary_stat_t,  LOG_SUMMARY_MAX,               1)  \
+    E(log_summary_stat_t,  LOG_SUMMARY_MEAN,              2)  \
+    E(log_summary_stat_t,  LOG_SUMMARY_LAST,              3)  \
+    E(log_link_mode_t,     LOG_LINK_MODE_FULL_RATE,       0)  \
+    E(log_link_mode_t,     LOG_LINK_MODE_SUMMARY,         1)  \
+    E(log_profile_phase_t, LOG_PROFILE_PHASE_UART,        0)  \
+    E(log_profile_phase_t, LOG_PROFILE_PHASE_POLL,        1)  \
+    E(log_profile_phase_t, LOG_PROFILE_PHASE_UPSTREAM_RX, 2)  \
+    E(log_profile_phase_t, LOG_PROFILE_PHASE_LINK,        3)  \
+    E(log_profile_phase_t, LOG_PROFILE_PHASE_DEBUG,       4)  \
+    E(log_profile_phase_t, LOG_PROFILE_PHASE_RING,        5)  \
+    E(log_profile_phase_t, LOG_PROFILE_PHASE_WRITE,       6)  \
+    E(log_profile_phase_t, LOG_PROFILE_PHASE_BUSY,        7)  \
+    E(log_profile_phase_t, LOG_PROFILE_PHASE_IDLE,        8)  \
+    E(log_profile_phase_t, LOG_PROFILE_PHASE_OUTSIDE,     9)
+
+#define LOG_SCHEMA_FIELDS_control_loop(F) \
+    F(float,    raw_gyro_x)               \
+    F(float,    raw_gyro_y)               \
+    F(float,    raw_gyro_z)               \
+    F(float,    filtered_gyro_x)          \
+    F(float,    filtered_gyro_y)          \
+    F(float,    filtered_gyro_z)          \
+    F(uint16_t, rc_in_roll)               \
+    F(uint16_t, rc_in_pitch)              \
+    F(uint16_t, rc_in_yaw)                \
+    F(uint16_t, rc_in_throttle)           \
+    F(float,    setpoint_roll)            \
+    F(float,    setpoint_pitch)           \
+    F(float,    setpoint_yaw)             \
+    F(float,    setpoint_throttle)        \
+    F(bool,     is_connected)             \
+    F(bool,     is_armed)                 \
+    F(bool,     can_run_motors)           \
+    F(float,    roll_error)               \
+    F(float,    roll_error_integral)      \
+    F(float,    roll_p)                   \
+    F(float,    roll_i)                   \
+    F(float,    roll_d)                   \
+    F(float,    roll_pid)                 \
+    F(float,    roll_adjust)              \
+    F(float,    pitch_error)              \
+    F(float,    pitch_error_integral)     \
+    F(float,    pitch_p)                  \
+    F(float,    pitch_i)                  \
+    F(float,    pitch_d)                  \
+    F(float,    pitch_pid)                \
+    F(float,    pitch_adjust)             \
+    F(float,    yaw_error)                \
+    F(float,    yaw_error_integral)       \
+    F(float,    yaw_p)                    \
+    F(float,    yaw_i)                    \
+    F(float,    yaw_d)                    \
+    F(float,    yaw_pid)                  \
+    F(float,    yaw_adjust)               \
+    F(float,    m1_non_restricted)        \
+    F(float,    m2_non_restricted)        \
+    F(float,    m3_non_restricted)        \
+    F(float,    m4_non_restricted)        \
+    F(float,    m1_restricted)            \
+    F(float,    m2_restricted)            \
+    F(float,    m3_restricted)            \
+    F(float,    m4_restricted)            \
+    F(float,    battery)
+
+#define LOG_SCHEMA_FIELDS_battery(F) \
+    F(float,    voltage)
+
+// Sent by the node instead of control_loop blocks when the link is
+// congested: one block per log_summary_stat_t over a window of samples.
+// The header timestamp is the end of the window.
+#define LOG_SCHEMA_FIELDS_control_loop_summary(F) \
+    F(uint8_t,  stat)                             \
+    F(uint16_t, samples)                          \
+    F(uint32_t, window_start)                     \
+    LOG_SCHEMA_FIELDS_control_loop(F)
+
+// Sent by the node when it switches log_link_mode_t
+#define LOG_SCHEMA_FIELDS_link_mode(F) \
+    F(uint8_t,  mode)                  \
+    F(uint16_t, ring_used)             \
+    F(uint16_t, ring_size)             \
+    F(uint32_t, drain_rate)            \
+    F(uint32_t, input_rate)            \
+    F(uint16_t, discarded_packets)
+
+// Main loop profiler statistics of one log_profile_phase_t, sent on
+// VSTP_CMD_PROFILE_DUMP (see include/vstp_profile.h). hist_N counts the
+// calls that took [2^(N+4), 2^(N+5)) cycles, hist_0 and hist_15 are open.
+#define LOG_SCHEMA_FIELDS_profile_phase(F) \
+    F(uint8_t,  phase)                     \
+    F(uint32_t, calls)                     \
+    F(uint64_t, total_cycles)              \
+    F(uint32_t, max_cycles)                \
+    F(uint16_t, cycles_per_us)             \
+    F(uint32_t, elapsed_ms)                \
+    F(uint32_t, listen_restarts)           \
+    F(uint32_t, hist_0)                    \
+    F(uint32_t, hist_1)                    \
+    F(uint32_t, hist_2)                    \
+    F(uint32_t, hist_3)                    \
+    F(uint32_t, hist_4)                    \
+    F(uint32_t, hist_5)                    \
+    F(uint32_t, hist_6)                    \
+    F(uint32_t, hist_7)                    \
+    F(uint32_t, hist_8)                    \
+    F(uint32_t, hist_9)                    \
+    F(uint32_t, hist_10)                   \
+    F(uint32_t, hist_11)                   \
+    F(uint32_t, hist_12)                   \
+    F(uint32_t, hist_13)                   \
+    F(uint32_t, hist_14)                   \
+    F(uint32_t, hist_15)
+
+// Sent by the node instead of control_loop blocks when the FC has set a field
+// filter with VSTP_CMD_LOG_FILTER. Only the fields in field_mask follow.
+#define LOG_SCHEMA_FIELDS_control_loop_filtered(F) \
+    F(uint64_t, field_mask)
+
+
+#endif /* LOG_SCHEMA_DEF_H */
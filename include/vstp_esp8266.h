@@ -0,0 +1,68 @@
+#ifndef VSTP_ESP8266_H
+#define VSTP_ESP8266_H
+
+/*
+ * VstpNode I/O policies for the ESP8266: the flight controller is on the
+ * hardware UART and clients connect to a TCP server over WiFi.
+ */
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+
+// lwIP tcp state of a server that isn't listening
+#define SERVER_NOT_CONNECTED 0
+
+
+struct Esp8266SerialUart
+{
+    inline int read()
+    {
+        return Serial.read();
+    }
+};
+
+template <uint16_t Port>
+class WiFiServerTransport
+{
+public:
+    WiFiServerTransport() : server_(Port) {}
+
+    inline bool poll()
+    {
+        if (server_.status() == SERVER_NOT_CONNECTED)
+        {
+            server_.begin();
+            return true;
+        }
+        return false;
+    }
+
+    inline bool connected()
+    {
+        return client_.connected();
+    }
+
+    inline bool accept()
+    {
+        client_ = server_.available();
+        return client_.connected();
+    }
+
+    inline int read()
+    {
+        return client_.read();
+    }
+
+    inline size_t write(const uint8_t* data, const size_t size)
+    {
+        return client_.write(data, size);
+    }
+
+private:
+    WiFiServer server_;
+    WiFiClient client_;
+};
+
+
+#endif /* VSTP_ESP8266_H */
@@ -0,0 +1,139 @@
+#ifndef VSTP_LINK_H
+#define VSTP_LINK_H
+
+/*
+ * Windowed summaries of control loop blocks, sent by the node instead of
+ * the raw blocks when the upstream link is congested (see vstp.h).
+ */
+
+#include "stddef.h"
+#include "string.h"
+
+#include "log_schema.h"
+
+
+class ControlLoopSummary
+{
+public:
+    typedef log_block_traits<log_block_data_control_loop_t>         traits;
+    typedef log_block_traits<log_block_data_control_loop_summary_t> summary_traits;
+
+    // Offset of the embedded control loop fields within the summary data
+    static constexpr size_t data_offset = sizeof(log_block_data_control_loop_summary_t) - traits::data_size;
+    static_assert(summary_traits::fields[summary_traits::field::raw_gyro_x].offset == data_offset,
+                  "control_loop_summary must end with the control_loop fields");
+
+    ControlLoopSummary()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        samples_ = 0;
+    }
+
+    uint16_t samples() const { return samples_; }
+
+    /* Adds the data of one control loop block, timestamped by the FC, to the window */
+    inline void add(const uint32_t timestamp, const uint8_t* data)
+    {
+        memcpy(&last_, data, traits::data_size);
+
+        if (samples_ == 0)
+        {
+            window_start_ = timestamp;
+            min_ = last_;
+            max_ = last_;
+            traits::visit(last_, Sum { sum_, true });
+        }
+        else
+        {
+            traits::combine(min_, last_, Min());
+            traits::combine(max_, last_, Max());
+            traits::visit(last_, Sum { sum_, false });
+        }
+        samples_++;
+    }
+
+    /*
+     * Encodes the summary block of the given log_summary_stat_t into out,
+     * with timestamp as the end of the window.
+     * Returns the number of bytes written, or 0 if out is too small.
+     */
+    inline size_t encode(const uint8_t stat, const uint32_t timestamp, const uint32_t id,
+                         uint8_t* out, const size_t out_size) const
+    {
+        log_block_data_control_loop_summary_t summary;
+        summary.stat = stat;
+        summary.samples = samples_;
+        summary.window_start = window_start_;
+
+        log_block_data_control_loop_t stats = last_;
+        switch (stat)
+        {
+            case LOG_SUMMARY_MIN:  stats = min_; break;
+            case LOG_SUMMARY_MAX:  stats = max_; break;
+            case LOG_SUMMARY_MEAN: traits::combine(stats, stats, Mean { sum_, samples_ }); break;
+            default:               break;
+        }
+        memcpy(((uint8_t*) &summary) + data_offset, &stats, traits::data_size);
+
+        return log_block_encode(out, out_size, timestamp, id, summary);
+    }
+
+private:
+    // Per field code for traits::visit() and traits::combine(), so every
+    // field is compared and summed with its own type
+    struct Min
+    {
+        template <typename T>
+        T operator()(const uint8_t, const T min, const T value) const { return (value < min) ? value : min; }
+    };
+
+    struct Max
+    {
+        template <typename T>
+        T operator()(const uint8_t, const T max, const T value) const { return (value > max) ? value : max; }
+    };
+
+    struct Sum
+    {
+        float*     sum;
+        const bool first;
+
+        template <typename T>
+        void operator()(const uint8_t i, const char*, const T value) const
+        {
+            sum[i] = first ? (float) value : (sum[i] + (float) value);
+        }
+    };
+
+    struct Mean
+    {
+        const float*   sum;
+        const uint16_t samples;
+
+        template <typename T>
+        T operator()(const uint8_t i, const T, const T) const { return from_float(sum[i] / samples, T()); }
+    };
+
+    // The mean back in the type of the field, integers rounded
+    static inline float from_float(const float value, float) { return value; }
+    static inline bool  from_float(const float value, bool)  { return value >= 0.5f; }
+    template <typename T>
+    static inline T from_float(const float value, T)
+    {
+        return (T) ((value < 0) ? (value - 0.5f) : (value + 0.5f));
+    }
+
+    uint16_t                      samples_;
+    uint32_t                      window_start_;
+    log_block_data_control_loop_t min_;
+    log_block_data_control_loop_t max_;
+    float                         sum_[traits::nbr_of_fields];
+    log_block_data_control_loop_t last_;
+};
+
+
+#endif /* VSTP_LINK_H */
@@ -0,0 +1,852 @@
+#ifndef VSTP_NODE_H
+#define VSTP_NODE_H
+
+/*
+ * VSTP telemetry node.
+ *
+ * VstpNode<UartPolicy, TransportPolicy, RingBytes, MaxPayload> reads VSTP
+ * packets from the flight controller, buffers the log data in an RX ring
+ * and streams it upstream. Everything is sized at compile time and lives
+ * inside the node object, so a node can be a plain static with no heap
+ * allocation, and sizeof() of it is its complete RAM cost.
+ *
+ * UartPolicy must provide:
+ *   int read();                  Next RX byte, or -1 if none is available
+ *
+ * TransportPolicy must provide:
+ *   bool   poll();               (Re)starts listening for clients if needed,
+ *                                true if it had to
+ *   bool   connected();          True if an upstream client is connected
+ *   bool   accept();             Accepts a pending client, true if connected
+ *   int    read();               Next byte from the client, or -1 if none
+ *   size_t write(data, size);    Writes upstream, returns bytes written
+ *
+ * The policies are held by value and called directly, so reads and writes
+ * inline into update().
+ *
+ * The node measures its upstream drain rate and ring occupancy, and when
+ * the link can't keep up it switches to LOG_LINK_MODE_SUMMARY, where
+ * control loop blocks are replaced by periodic windowed summaries. Every
+ * switch is marked in the stream by a link_mode block (see vstp.h).
+ *
+ * The FC can restrict the control loop fields sent at full rate with
+ * VSTP_CMD_LOG_FILTER. The node then sends control_loop_filtered blocks,
+ * with only the fields of the mask (see log_block_encode_filtered()).
+ *
+ * Built with -D VSTP_PROFILE, update() is profiled per phase, see
+ * vstp_profile.h. Only then does the node read commands from upstream.
+ */
+
+#include "stddef.h"
+#include "string.h"
+
+#include "vstp.h"
+#include "vstp_platform.h"
+#include "log_schema.h"
+#include "vstp_link.h"
+#include "vstp_profile.h"
+
+
+/*
+ * Parses a stream of bytes into VSTP packets.
+ */
+template <size_t MaxPayload>
+class VstpParser
+{
+public:
+    static_assert(MaxPayload <= VSTP_PACKET_MAX_PAYLOAD_SIZE,
+                  "VSTP payloads are at most VSTP_PACKET_MAX_PAYLOAD_SIZE bytes");
+
+    VstpParser()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        fsm_ = FSM_STATE_WAIT_FOR_CMD;
+        bytes_read_ = 0;
+        parse_errors = 0;
+    }
+
+    /*
+     * Process a single byte in the internal state machine.
+     * Returns true when a complete packet with a valid CRC has been read,
+     * which is then available in cmd(), len() and data() until the next call.
+     */
+    inline bool process_byte(const uint8_t byte)
+    {
+        vstp_fsm_state_t next_state = fsm_;
+        bool validate_packet = false;
+        bool packet_ok = false;
+
+        switch (fsm_)
+        {
+            case FSM_STATE_WAIT_FOR_CMD:
+            {
+                if (valid_command(byte))
+                {
+                    cmd_ = (vstp_cmd_t) byte;
+                    rx_crc_ = byte;
+                    next_state = FSM_STATE_WAIT_FOR_LENGTH;
+                }
+                else
+                {
+                    parse_errors++;
+                }
+                break;
+            }
+            case FSM_STATE_WAIT_FOR_LENGTH:
+            {
+                if (byte <= MaxPayload)
+                {
+                    len_ = byte;
+                    rx_crc_ ^= byte;
+                    next_state = FSM_STATE_WAIT_FOR_CRC;
+                }
+                else
+                {
+                    parse_errors++;
+                    next_state = FSM_STATE_WAIT_FOR_CMD;
+                }
+                break;
+            }
+            case FSM_STATE_WAIT_FOR_CRC:
+            {
+                crc_ = byte;
+                if (len_ > 0)
+                {
+                    next_state = FSM_STATE_READING_DATA;
+                }
+                else
+                {   // RX packet contains no data
+                    validate_packet = true;
+                }
+                break;
+            }
+            case FSM_STATE_READING_DATA:
+            {
+                data_[bytes_read_] = byte;
+                rx_crc_ ^= byte;
+                bytes_read_++;
+
+                if (bytes_read_ >= len_)
+                {
+                    validate_packet = true;
+                }
+                break;
+            }
+        }
+
+        if (validate_packet)
+        {
+            if (rx_crc_ == crc_)
+            {
+                packet_ok = true;
+            }
+            else
+            {   // Incorrect CRC
+                parse_errors++;
+            }
+
+            bytes_read_ = 0;
+            next_state = FSM_STATE_WAIT_FOR_CMD;
+        }
+
+        fsm_ = next_state;
+        return packet_ok;
+    }
+
+    vstp_cmd_t     cmd() const  { return cmd_; }
+    uint8_t        len() const  { return len_; }
+    const uint8_t* data() const { return data_; }
+
+    uint16_t parse_errors;
+
+private:
+    static bool valid_command(const uint8_t command)
+    {
+        return (command >= VSTP_LOWEST_CMD_VALUE) && (command <= VSTP_NBR_OF_CMDS);
+    }
+
+    vstp_fsm_state_t fsm_;
+    uint8_t          bytes_read_;
+    uint8_t          rx_crc_;
+    vstp_cmd_t       cmd_;
+    uint8_t          len_;
+    uint8_t          crc_;
+    uint8_t          data_[MaxPayload];
+};
+
+
+/*
+ * FIFO of variable sized packets, stored back to back as [len][data].
+ * Unlike fixed size slots, small packets only use the bytes they need.
+ */
+template <size_t RingBytes>
+class VstpRing
+{
+public:
+    static_assert((RingBytes & (RingBytes - 1)) == 0, "RingBytes must be a power of two");
+    static_assert(RingBytes <= 0x8000, "RingBytes must fit in 16 bit indices");
+
+    static constexpr size_t capacity = RingBytes;
+
+    VstpRing()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        head_ = 0;
+        tail_ = 0;
+        packets_ = 0;
+    }
+
+    /* Returns false if there is not enough room for the packet */
+    inline bool push(const uint8_t* data, const uint8_t len)
+    {
+        if ((size_t) (len + 1) > (RingBytes - used()))
+        {
+            return false;
+        }
+
+        buf_[head_ & MASK] = len;
+        copy_in(head_ + 1, data, len);
+        head_ += len + 1;
+        packets_++;
+        return true;
+    }
+
+    /* Copies the oldest packet to out. Returns its length, or -1 if empty. */
+    inline int peek(uint8_t* out) const
+    {
+        if (packets_ == 0)
+        {
+            return -1;
+        }
+
+        const uint8_t len = buf_[tail_ & MASK];
+        copy_out(tail_ + 1, out, len);
+        return len;
+    }
+
+    /* Removes the oldest packet */
+    inline void pop()
+    {
+        if (packets_ == 0)
+        {
+            // Should never happen!
+            DEBUG_PRINTF("Tried to pop empty ring!");
+            return;
+        }
+
+        tail_ += buf_[tail_ & MASK] + 1;
+        packets_--;
+    }
+
+    size_t used() const    { return (uint16_t) (head_ - tail_); }
+    size_t packets() const { return packets_; }
+
+private:
+    static constexpr size_t MASK = RingBytes - 1;
+
+    inline void copy_in(const size_t at, const uint8_t* data, const size_t len)
+    {
+        const size_t start = at & MASK;
+        const size_t first = (len < RingBytes - start) ? len : RingBytes - start;
+        memcpy(&buf_[start], data, first);
+        memcpy(&buf_[0], data + first, len - first);
+    }
+
+    inline void copy_out(const size_t at, uint8_t* out, const size_t len) const
+    {
+        const size_t start = at & MASK;
+        const size_t first = (len < RingBytes - start) ? len : RingBytes - start;
+        memcpy(out, &buf_[start], first);
+        memcpy(out + first, &buf_[0], len - first);
+    }
+
+    // Free running indices, wrapped with MASK when accessing buf_
+    uint16_t head_;
+    uint16_t tail_;
+    uint16_t packets_;
+    uint8_t  buf_[RingBytes];
+};
+
+
+template <typename UartPolicy, typename TransportPolicy, size_t RingBytes, size_t MaxPayload>
+class VstpNode
+{
+public:
+    static_assert(RingBytes >= MaxPayload + 1, "RX ring must hold at least one packet");
+
+    static constexpr size_t ring_bytes = RingBytes;
+    static constexpr size_t max_payload = MaxPayload;
+
+    // Upper bound of UART bytes handled per update(), one full packet
+    static constexpr size_t uart_bytes_per_update = MaxPayload + VSTP_PACKET_HEADER_SIZE;
+    // Upper bound of command bytes read from the client per update()
+    static constexpr size_t upstream_bytes_per_update = VSTP_PACKET_HEADER_SIZE;
+
+    VstpNode()
+    {
+        reset();
+    }
+
+    /*
+     * Resets all states and empties the RX ring.
+     */
+    void reset()
+    {
+        // States
+        is_logging_upstream_ = false;
+        is_logging_to_sd_ = false;
+        is_logging_debug_ = false;
+
+        // RX Parsing states
+        parser_.reset();
+#ifdef VSTP_PROFILE
+        upstream_parser_.reset();
+#endif
+        discarded_packets_ = 0;
+        listen_restarts_ = 0;
+        profile_dump_pending_ = false;
+        field_mask_ = ControlLoopSummary::traits::all_fields;
+
+        // RX and TX buffers
+        ring_.clear();
+        tx_size_ = 0;
+        tx_sent_ = 0;
+
+        last_upstream_tx_ = 0;
+        t0_debug_msg_ = 0;
+
+        // Link monitoring
+        const uint32_t now = vstp_millis();
+        link_mode_ = LOG_LINK_MODE_FULL_RATE;
+        summary_.reset();
+        last_fc_timestamp_ = 0;
+        last_fc_id_ = 0;
+        input_bytes_ = 0;
+        drain_bytes_ = 0;
+        input_rate_ = 0;
+        drain_rate_ = 0;
+        t0_rate_ = now;
+        t0_summary_ = now;
+        t0_ring_high_ = now;
+        t_recovered_ = now - VSTP_LINK_STABLE_MS;
+        recover_hold_ms_ = VSTP_LINK_RECOVER_HOLD_MS;
+
+        profiler_.reset();
+    }
+
+    /*
+     * Reads pending UART bytes and performs next transmission of data (if needed).
+     * Returns true if any work was done.
+     */
+    inline bool update()
+    {
+        const uint32_t t_update = profiler_.begin_update();
+        uint32_t t = t_update;
+        bool did_work = false;
+
+        // Read bytes from RX UART and process in fsm.
+        for (size_t i = 0; i < uart_bytes_per_update; i++)
+        {
+            const int next_byte = uart_.read();
+            if (next_byte == -1)
+            {
+                break;
+            }
+            process_byte((uint8_t) next_byte);
+            did_work = true;
+        }
+        t = profiler_.lap(LOG_PROFILE_PHASE_UART, t);
+
+        if (transport_.poll())
+        {
+            listen_restarts_++;
+        }
+        t = profiler_.lap(LOG_PROFILE_PHASE_POLL, t);
+
+        // Only the profiler is controlled from upstream, so without it
+        // there is nothing to read
+        if (VstpProfiler::enabled)
+        {
+            if (transport_.connected())
+            {
+                read_upstream_commands();
+            }
+            if (profile_dump_pending_)
+            {
+                push_profile();
+            }
+        }
+        t = profiler_.lap(LOG_PROFILE_PHASE_UPSTREAM_RX, t);
+
+        const uint32_t now = vstp_millis();
+        update_link(now);
+        t = profiler_.lap(LOG_PROFILE_PHASE_LINK, t);
+
+        if ((now - t0_debug_msg_) > 1000)
+        {
+            DEBUG_PRINTF("Parse errs: %d, ", parser_.parse_errors);
+            DEBUG_PRINTF("ring: %d B / %d pkts, ", (int) ring_.used(), (int) ring_.packets());
+            DEBUG_PRINTF("discarded: %d, ", discarded_packets_);
+            DEBUG_PRINTF("listen restarts: %d, ", (int) listen_restarts_);
+            DEBUG_PRINTF("link: %d (in %d B/s, out %d B/s), ", link_mode_, (int) input_rate_, (int) drain_rate_);
+            DEBUG_PRINTF("log_upstream: %d, ", is_logging_upstream_);
+            DEBUG_PRINTF("log_sd: %d, ", is_logging_to_sd_);
+            DEBUG_PRINTF("log_debug: %d", is_logging_debug_);
+            DEBUG_PRINTF("\n");
+            t0_debug_msg_ = now;
+        }
+        t = profiler_.lap(LOG_PROFILE_PHASE_DEBUG, t);
+
+        // Load the oldest packet in the RX ring into the TX buffer
+        if (tx_size_ == 0)
+        {
+            const int size = ring_.peek(tx_buf_);
+            if (size == 0)
+            {   // Empty log data packet, nothing to send
+                ring_.pop();
+            }
+            else if (size > 0)
+            {
+                tx_size_ = (uint8_t) size;
+                tx_sent_ = 0;
+            }
+        }
+        t = profiler_.lap(LOG_PROFILE_PHASE_RING, t);
+
+        if (tx_size_ > 0)
+        {
+            bool upstream_logged_ok = false;
+
+            if (is_logging_upstream_)
+            {
+                upstream_logged_ok = transmit_upstream_data();
+                did_work = true;
+            }
+            if (is_logging_to_sd_)
+            {
+                // TODO
+            }
+            if (is_logging_debug_)
+            {
+                // TODO
+            }
+
+            if (upstream_logged_ok)
+            {
+                ring_.pop();
+                tx_size_ = 0;
+                last_upstream_tx_ = now;
+            }
+        }
+        t = profiler_.lap(LOG_PROFILE_PHASE_WRITE, t);
+
+        profiler_.end_update(t_update, t, did_work);
+        return did_work;
+    }
+
+    /*
+     * Process a single byte in the VSTP state machine
+     */
+    inline void process_byte(const uint8_t byte)
+    {
+        if (parser_.process_byte(byte))
+        {
+            handle_incoming_packet(parser_.cmd());
+        }
+    }
+
+    UartPolicy&      uart()      { return uart_; }
+    TransportPolicy& transport() { return transport_; }
+
+    uint16_t parse_errors() const      { return parser_.parse_errors; }
+    uint16_t discarded_packets() const { return discarded_packets_; }
+    size_t   ring_used() const         { return ring_.used(); }
+    size_t   ring_packets() const      { return ring_.packets(); }
+    bool     is_logging_upstream() const { return is_logging_upstream_; }
+    uint32_t listen_restarts() const   { return listen_restarts_; }
+    uint8_t  link_mode() const         { return link_mode_; }
+    uint32_t input_rate() const        { return input_rate_; }
+    uint32_t drain_rate() const        { return drain_rate_; }
+    uint64_t field_mask() const        { return field_mask_; }
+
+private:
+    // Every log block must fit in the payload of a single VSTP packet
+#define LOG_SCHEMA_X(block, log_type, value)                        \
+    static_assert(sizeof(log_block_##block##_t) <= MaxPayload,     \
+                  "log_block_" #block "_t does not fit in MaxPayload");
+    LOG_SCHEMA_BLOCKS(LOG_SCHEMA_X)
+#undef LOG_SCHEMA_X
+
+    /*
+     * Tries to transmit the TX buffer upstream to a connected client.
+     * If no client is connected, we see if any pending connections are
+     * waiting and if so, we accept them.
+     * Returns true once the whole TX buffer has been written. Partial
+     * writes are resumed on the next call.
+     */
+    inline bool transmit_upstream_data()
+    {
+        if (!transport_.connected())
+        {
+            // No client connected, try to accept incoming connections
+            if (!transport_.accept())
+            {
+                // Still no client connected? then we'll return
+                return false;
+            }
+
+            // A new client must get the log block from its start
+            tx_sent_ = 0;
+        }
+
+        const size_t written = transport_.write(&tx_buf_[tx_sent_], tx_size_ - tx_sent_);
+        tx_sent_ += written;
+        drain_bytes_ += written;
+        return tx_sent_ >= tx_size_;
+    }
+
+    // -- Link monitoring -- //
+
+    /*
+     * Updates the rate estimates and switches link mode when needed.
+     *
+     * The drain rate says little about what the link could take while we
+     * only send summaries, so recovery is decided on ring occupancy alone:
+     * the ring must stay below VSTP_LINK_RECOVERED_PCT for the hold time.
+     * Congesting again shortly after recovering doubles the hold time, so a
+     * link that can't sustain full rate doesn't flap between the modes.
+     */
+    inline void update_link(const uint32_t now)
+    {
+        const uint32_t rate_dt = now - t0_rate_;
+        if (rate_dt >= VSTP_LINK_RATE_WINDOW_MS)
+        {
+            input_rate_ = (uint32_t) ((uint64_t) input_bytes_ * 1000 / rate_dt);
+            drain_rate_ = (uint32_t) ((uint64_t) drain_bytes_ * 1000 / rate_dt);
+            input_bytes_ = 0;
+            drain_bytes_ = 0;
+            t0_rate_ = now;
+        }
+
+        const size_t used_pct = ring_.used() * 100 / RingBytes;
+
+        if (link_mode_ == LOG_LINK_MODE_FULL_RATE)
+        {
+            if (used_pct >= VSTP_LINK_CONGESTED_PCT)
+            {
+                if ((now - t_recovered_) < VSTP_LINK_STABLE_MS)
+                {
+                    recover_hold_ms_ *= 2;
+                    if (recover_hold_ms_ > VSTP_LINK_RECOVER_HOLD_MAX_MS)
+                    {
+                        recover_hold_ms_ = VSTP_LINK_RECOVER_HOLD_MAX_MS;
+                    }
+                }
+                else
+                {
+                    recover_hold_ms_ = VSTP_LINK_RECOVER_HOLD_MS;
+                }
+
+                summary_.reset();
+                t0_summary_ = now;
+                t0_ring_high_ = now;
+                set_link_mode(LOG_LINK_MODE_SUMMARY);
+            }
+            return;
+        }
+
+        if ((now - t0_summary_) >= VSTP_LINK_SUMMARY_PERIOD_MS)
+        {
+            push_summary();
+            t0_summary_ = now;
+        }
+
+        if (used_pct > VSTP_LINK_RECOVERED_PCT)
+        {
+            t0_ring_high_ = now;
+        }
+        else if ((now - t0_ring_high_) >= recover_hold_ms_)
+        {
+            // Samples of the last window must come before the switch
+            push_summary();
+            set_link_mode(LOG_LINK_MODE_FULL_RATE);
+            t_recovered_ = now;
+        }
+    }
+
+    /* Pushes the summary blocks of the current window, if it has any samples */
+    inline void push_summary()
+    {
+        if (summary_.samples() == 0)
+        {
+            return;
+        }
+
+        uint8_t block[ControlLoopSummary::summary_traits::wire_size];
+        for (uint8_t stat = LOG_SUMMARY_MIN; stat <= LOG_SUMMARY_LAST; stat++)
+        {
+            const size_t size = summary_.encode(stat, last_fc_timestamp_, last_fc_id_, block, sizeof(block));
+            push_block(block, size);
+        }
+        summary_.reset();
+    }
+
+    inline void set_link_mode(const uint8_t mode)
+    {
+        DEBUG_PRINTF("Link mode %d -> %d\n", link_mode_, mode);
+        link_mode_ = mode;
+
+        log_block_data_link_mode_t marker;
+        marker.mode = mode;
+        marker.ring_used = (uint16_t) ring_.used();
+        marker.ring_size = (uint16_t) RingBytes;
+        marker.drain_rate = drain_rate_;
+        marker.input_rate = input_rate_;
+        marker.discarded_packets = discarded_packets_;
+
+        uint8_t block[log_block_traits<log_block_data_link_mode_t>::wire_size];
+        const size_t size = log_block_encode(block, sizeof(block), last_fc_timestamp_, last_fc_id_, marker);
+        push_block(block, size);
+    }
+
+    /* Pushes a block generated by the node into the RX ring */
+    inline void push_block(const uint8_t* block, const size_t size)
+    {
+        if (!ring_.push(block, (uint8_t) size))
+        {
+            DEBUG_PRINTF("Discarding packet\n");
+            discarded_packets_++;
+        }
+    }
+
+    /*
+     * Parses commands sent by the upstream client. Only the profiler is
+     * controlled from upstream, everything else comes from the FC.
+     */
+    inline void read_upstream_commands()
+    {
+#ifdef VSTP_PROFILE
+        for (size_t i = 0; i < upstream_bytes_per_update; i++)
+        {
+            const int next_byte = transport_.read();
+            if (next_byte == -1)
+            {
+                break;
+            }
+            if (upstream_parser_.process_byte((uint8_t) next_byte))
+            {
+                switch (upstream_parser_.cmd())
+                {
+                    case VSTP_CMD_PROFILE_DUMP:
+                        cmd_handler_profile_dump();
+                        break;
+                    case VSTP_CMD_PROFILE_RESET:
+                        cmd_handler_profile_reset();
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+#endif
+    }
+
+    inline void handle_incoming_packet(const vstp_cmd_t cmd)
+    {
+        switch (cmd)
+        {
+            case VSTP_CMD_LOG_START:
+            {
+                cmd_handler_log_start();
+                break;
+            }
+            case VSTP_CMD_LOG_STOP:
+            {
+                cmd_handler_log_stop();
+                break;
+            }
+            case VSTP_CMD_LOG_DATA:
+            {
+                cmd_handler_log_data();
+                break;
+            }
+            case VSTP_CMD_LOG_SD_START:
+            {
+                cmd_handler_log_sd_start();
+                break;
+            }
+            case VSTP_CMD_LOG_SD_STOP:
+            {
+                cmd_handler_log_sd_stop();
+                break;
+            }
+            case VSTP_CMD_RESET:
+                reset();
+                break;
+            case VSTP_CMD_LOG_FILTER:
+                cmd_handler_log_filter();
+                break;
+            case VSTP_CMD_PROFILE_DUMP:
+            case VSTP_CMD_PROFILE_RESET:
+                // Upstream only
+                break;
+        }
+    }
+
+    // -- Profiling -- //
+
+    /*
+     * Pushes one profile_phase block per phase. The dump is an answer to
+     * the client, so it waits until the ring has room for all of it,
+     * instead of being discarded like log data.
+     */
+    inline void push_profile()
+    {
+        typedef log_block_traits<log_block_data_profile_phase_t> traits;
+
+        if ((RingBytes - ring_.used()) < (VSTP_PROFILE_NBR_OF_PHASES * (traits::wire_size + 1)))
+        {
+            return;
+        }
+
+        for (uint8_t phase = 0; phase < VSTP_PROFILE_NBR_OF_PHASES; phase++)
+        {
+            log_block_data_profile_phase_t stats;
+            profiler_.get_phase(phase, &stats);
+            stats.listen_restarts = listen_restarts_;
+
+            uint8_t block[traits::wire_size];
+            const size_t size = log_block_encode(block, sizeof(block), last_fc_timestamp_, last_fc_id_, stats);
+            push_block(block, size);
+        }
+        profile_dump_pending_ = false;
+    }
+
+    // -- Command handlers -- //
+    inline void cmd_handler_log_data()
+    {
+        const uint8_t* data = parser_.data();
+        const uint8_t len = parser_.len();
+        input_bytes_ += len;
+
+        if (len >= sizeof(log_block_header_t))
+        {
+            // Blocks generated by the node are stamped with the FC clock
+            log_block_header_t header;
+            memcpy(&header, data, sizeof(header));
+            last_fc_timestamp_ = header.timestamp;
+            last_fc_id_ = header.id;
+
+            if ((header.type == LOG_TYPE_PID) && (len == ControlLoopSummary::traits::wire_size))
+            {
+                if (link_mode_ == LOG_LINK_MODE_SUMMARY)
+                {
+                    summary_.add(header.timestamp, data + sizeof(header));
+                    return;
+                }
+                if (field_mask_ != ControlLoopSummary::traits::all_fields)
+                {
+                    push_filtered(data, len);
+                    return;
+                }
+            }
+        }
+
+        push_block(data, len);
+    }
+
+    /* Pushes the fields of field_mask_ of a control loop block */
+    inline void push_filtered(const uint8_t* data, const uint8_t len)
+    {
+        log_block_header_t header;
+        log_block_data_control_loop_t control_loop;
+        if (!log_block_decode(data, len, &header, &control_loop))
+        {
+            return;
+        }
+
+        uint8_t block[log_block_traits<log_block_data_control_loop_filtered_t>::wire_size +
+                      sizeof(log_block_data_control_loop_t)];
+        const size_t size = log_block_encode_filtered(block, sizeof(block), header.timestamp, header.id,
+                                                      control_loop, field_mask_);
+        push_block(block, size);
+    }
+
+    // An empty or short payload sends every field again
+    inline void cmd_handler_log_filter()
+    {
+        uint64_t mask = ControlLoopSummary::traits::all_fields;
+        if (parser_.len() == sizeof(mask))
+        {
+            memcpy(&mask, parser_.data(), sizeof(mask));
+        }
+        mask &= ControlLoopSummary::traits::all_fields;
+        // No fields, or no payload, clears the filter
+        field_mask_ = (mask != 0) ? mask : ControlLoopSummary::traits::all_fields;
+    }
+
+    void cmd_handler_log_start()     { is_logging_upstream_ = true; }
+    void cmd_handler_log_stop()      { is_logging_upstream_ = false; }
+    void cmd_handler_log_sd_start()  { is_logging_to_sd_ = true; }
+    void cmd_handler_log_sd_stop()   { is_logging_to_sd_ = false; }
+    // A dump sends nothing if the node isn't built with VSTP_PROFILE
+    void cmd_handler_profile_dump()  { profile_dump_pending_ = VstpProfiler::enabled; }
+    void cmd_handler_profile_reset() { profiler_.reset(); }
+
+    // States
+    bool                    is_logging_upstream_;
+    bool                    is_logging_to_sd_;
+    bool                    is_logging_debug_;
+
+    // RX parsing and buffering
+    VstpParser<MaxPayload>  parser_;
+    uint16_t                discarded_packets_;
+    uint32_t                listen_restarts_;
+    bool                    profile_dump_pending_;
+    uint64_t                field_mask_;        // control_loop fields sent at full rate
+    VstpRing<RingBytes>     ring_;
+
+    // TX buffer, holds the packet currently being sent upstream
+    uint8_t                 tx_buf_[MaxPayload];
+    uint8_t                 tx_size_;
+    uint8_t                 tx_sent_;
+
+    uint32_t                last_upstream_tx_;
+    uint32_t                t0_debug_msg_;
+
+    // Link monitoring
+    uint8_t                 link_mode_;
+    ControlLoopSummary      summary_;
+    uint32_t                last_fc_timestamp_;
+    uint32_t                last_fc_id_;
+    uint32_t                input_bytes_;
+    uint32_t                drain_bytes_;
+    uint32_t                input_rate_;
+    uint32_t                drain_rate_;
+    uint32_t                t0_rate_;
+    uint32_t                t0_summary_;
+    uint32_t                t0_ring_high_;
+    uint32_t                t_recovered_;
+    uint32_t                recover_hold_ms_;
+
+    // Upstream commands and profiling, the commands carry no payload
+#ifdef VSTP_PROFILE
+    VstpParser<4>           upstream_parser_;
+#endif
+    VstpProfiler            profiler_;
+
+    // I/O
+    UartPolicy              uart_;
+    TransportPolicy         transport_;
+};
+
+
+#endif /* VSTP_NODE_H */
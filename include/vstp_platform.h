@@ -0,0 +1,66 @@
+#ifndef VSTP_PLATFORM_H
+#define VSTP_PLATFORM_H
+
+/*
+ * The few platform functions the VSTP node needs, so that the same node
+ * code builds for the ESP8266 and for the host (see tools/host_node).
+ */
+
+#include "stdint.h"
+
+#ifdef ARDUINO
+    #include <Arduino.h>
+
+    static inline uint32_t vstp_millis()
+    {
+        return millis();
+    }
+
+    // CPU cycle counter (CCOUNT), wraps after 26 s at 160 MHz
+    static inline uint32_t vstp_cycles()
+    {
+        return ESP.getCycleCount();
+    }
+
+    static inline uint16_t vstp_cycles_per_us()
+    {
+        return ESP.getCpuFreqMHz();
+    }
+
+    #define VSTP_PRINTF(...) Serial.printf(__VA_ARGS__)
+#else
+    #include <chrono>
+    #include <cstdio>
+
+    static inline uint32_t vstp_millis()
+    {
+        using namespace std::chrono;
+        return (uint32_t) duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    // On the host a "cycle" is a nanosecond of the steady clock, so that
+    // profiles don't depend on the TSC frequency
+    static inline uint32_t vstp_cycles()
+    {
+        using namespace std::chrono;
+        return (uint32_t) duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    static inline uint16_t vstp_cycles_per_us()
+    {
+        return 1000;
+    }
+
+    #define VSTP_PRINTF(...) fprintf(stderr, __VA_ARGS__)
+#endif
+
+//#define DO_DEBUG
+
+#ifdef DO_DEBUG
+    #define DEBUG_PRINTF(...) VSTP_PRINTF(__VA_ARGS__)
+#else
+    #define DEBUG_PRINTF(...)
+#endif
+
+
+#endif /* VSTP_PLATFORM_H */
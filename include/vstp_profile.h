@@ -0,0 +1,158 @@
+#ifndef VSTP_PROFILE_H
+#define VSTP_PROFILE_H
+
+/*
+ * Main loop profiler of the VSTP node, enabled with -D VSTP_PROFILE.
+ *
+ * VstpNode::update() is split into the phases of log_profile_phase_t. Each
+ * phase is timed with the CPU cycle counter and accumulated into a fixed
+ * table of calls, total and max cycles and a log2 histogram. Every update()
+ * is also counted as BUSY or IDLE (no UART data and nothing sent), and the
+ * time between two update() calls, spent in the Arduino core and the WiFi
+ * stack, as OUTSIDE.
+ *
+ * The table is sent upstream as profile_phase blocks on VSTP_CMD_PROFILE_DUMP
+ * and cleared on VSTP_CMD_PROFILE_RESET, see tools/profile_dump.py.
+ *
+ * Without VSTP_PROFILE the profiler is an empty class whose methods inline
+ * to nothing, so the node pays no cycles for it.
+ */
+
+#include "stdint.h"
+#include "stddef.h"
+#include "string.h"
+
+#include "vstp_platform.h"
+#include "log_schema.h"
+
+
+#define VSTP_PROFILE_NBR_OF_PHASES (LOG_PROFILE_PHASE_OUTSIDE + 1)
+#define VSTP_PROFILE_HIST_BINS     16
+// hist_0 holds everything below 2^(VSTP_PROFILE_HIST_SHIFT + 1) cycles
+#define VSTP_PROFILE_HIST_SHIFT    4
+
+
+#ifdef VSTP_PROFILE
+
+class VstpProfiler
+{
+public:
+    static constexpr bool enabled = true;
+
+    VstpProfiler()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        memset(phases_, 0, sizeof(phases_));
+        t0_ms_ = vstp_millis();
+        has_exit_ = false;
+    }
+
+    /* Called first in update(), returns the start of the update */
+    inline uint32_t begin_update()
+    {
+        const uint32_t now = vstp_cycles();
+        if (has_exit_)
+        {
+            record(LOG_PROFILE_PHASE_OUTSIDE, now - t_exit_);
+        }
+        return now;
+    }
+
+    /* Ends a phase that started at t, returns the start of the next one */
+    inline uint32_t lap(const uint8_t phase, const uint32_t t)
+    {
+        const uint32_t now = vstp_cycles();
+        record(phase, now - t);
+        return now;
+    }
+
+    /* Called last in update(), with the end of its last phase */
+    inline void end_update(const uint32_t t_update, const uint32_t t, const bool did_work)
+    {
+        record(did_work ? LOG_PROFILE_PHASE_BUSY : LOG_PROFILE_PHASE_IDLE, t - t_update);
+        t_exit_ = t;
+        has_exit_ = true;
+    }
+
+    /* Fills in the statistics of a phase, except listen_restarts */
+    void get_phase(const uint8_t phase, log_block_data_profile_phase_t* out) const
+    {
+        const phase_t& p = phases_[phase];
+
+        out->phase = phase;
+        out->calls = p.calls;
+        out->total_cycles = p.total;
+        out->max_cycles = p.max;
+        out->cycles_per_us = vstp_cycles_per_us();
+        out->elapsed_ms = vstp_millis() - t0_ms_;
+        memcpy(((uint8_t*) out) + hist_offset, p.hist, sizeof(p.hist));
+    }
+
+private:
+    typedef log_block_traits<log_block_data_profile_phase_t> traits;
+
+    static constexpr size_t hist_offset = traits::fields[traits::field::hist_0].offset;
+    static_assert(hist_offset + VSTP_PROFILE_HIST_BINS * sizeof(uint32_t) == traits::data_size,
+                  "profile_phase must end with hist_0 .. hist_15");
+
+    typedef struct
+    {
+        uint32_t calls;
+        uint32_t max;
+        uint64_t total;
+        uint32_t hist[VSTP_PROFILE_HIST_BINS];
+    } phase_t;
+
+    inline void record(const uint8_t phase, const uint32_t cycles)
+    {
+        phase_t& p = phases_[phase];
+
+        p.calls++;
+        p.total += cycles;
+        if (cycles > p.max)
+        {
+            p.max = cycles;
+        }
+
+        // Index of the highest set bit, i.e. floor(log2(cycles))
+        const int log2 = (cycles == 0) ? 0 : (31 - __builtin_clz(cycles));
+        int bin = log2 - VSTP_PROFILE_HIST_SHIFT;
+        if (bin < 0)
+        {
+            bin = 0;
+        }
+        else if (bin >= VSTP_PROFILE_HIST_BINS)
+        {
+            bin = VSTP_PROFILE_HIST_BINS - 1;
+        }
+        p.hist[bin]++;
+    }
+
+    phase_t  phases_[VSTP_PROFILE_NBR_OF_PHASES];
+    uint32_t t0_ms_;
+    uint32_t t_exit_;
+    bool     has_exit_;
+};
+
+#else
+
+class VstpProfiler
+{
+public:
+    static constexpr bool enabled = false;
+
+    void reset() {}
+    inline uint32_t begin_update() { return 0; }
+    inline uint32_t lap(const uint8_t, const uint32_t) { return 0; }
+    inline void end_update(const uint32_t, const uint32_t, const bool) {}
+    void get_phase(const uint8_t, log_block_data_profile_phase_t*) const {}
+};
+
+#endif /* VSTP_PROFILE */
+
+
+#endif /* VSTP_PROFILE_H */
@@ -0,0 +1,55 @@
+'''
+PlatformIO post build script that prints the static RAM budget of the
+firmware: .data/.bss totals and the largest RAM symbols, with the VSTP
+node object broken out.
+
+Enabled with `extra_scripts = post:scripts/ram_report.py` in platformio.ini.
+'''
+import subprocess
+
+Import('env')
+
+# ESP8266 user DRAM (dram0_0_seg)
+DRAM_SIZE = 80 * 1024
+RAM_SECTIONS = ('.data', '.rodata', '.bss')
+TOP_SYMBOLS = 10
+
+
+def ram_report(source, target, env) -> None:
+    elf = str(target[0])
+    tool_prefix = env.subst('$CC')[:-len('gcc')]
+
+    sections = {}
+    out = subprocess.run([tool_prefix + 'size', '-A', elf], capture_output=True, text=True).stdout
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) >= 2 and parts[0] in RAM_SECTIONS:
+            sections[parts[0]] = int(parts[1])
+
+    symbols = []
+    out = subprocess.run([tool_prefix + 'nm', '-S', '-C', '--size-sort', elf], capture_output=True, text=True).stdout
+    for line in out.splitlines():
+        parts = line.split(maxsplit=3)
+        if len(parts) == 4 and parts[2] in 'bBdD':
+            symbols.append((int(parts[1], 16), parts[3]))
+    symbols.sort(reverse=True)
+
+    total = sum(sections.values())
+    print('')
+    print('Static RAM budget')
+    print('-----------------')
+    for name, size in sections.items():
+        print(f'{name:<10} {size:>8} B')
+    print(f'{"total":<10} {total:>8} B ({100 * total / DRAM_SIZE:.1f}% of {DRAM_SIZE} B DRAM, '
+          f'{DRAM_SIZE - total} B left for heap and stack)')
+    print('')
+    for size, name in symbols:
+        if 'vstp_node' in name:
+            print(f'VSTP node: {size} B ({name})')
+    print('Largest RAM symbols:')
+    for size, name in symbols[:TOP_SYMBOLS]:
+        print(f'  {size:>8} B  {name}')
+    print('')
+
+
+env.AddPostAction('$BUILD_DIR/${PROGNAME}.elf', ram_report)
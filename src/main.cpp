@@ -1,15 +1,33 @@
-#include "vstp.h"
+#include "vstp_node.h"
+#include "vstp_esp8266.h"
 #include "credentials.h"
 
 #include <ESP8266WiFi.h>
 
-static vstp_state_t vstp_state;
 
+// Node variant, override with build_flags in platformio.ini
+#ifndef VSTP_NODE_RING_BYTES
+    #define VSTP_NODE_RING_BYTES  16384
+#endif
+#ifndef VSTP_NODE_MAX_PAYLOAD
+    #define VSTP_NODE_MAX_PAYLOAD VSTP_PACKET_MAX_PAYLOAD_SIZE
+#endif
+#ifndef VSTP_NODE_RAM_BUDGET
+    #define VSTP_NODE_RAM_BUDGET  (24 * 1024)
+#endif
+
+typedef VstpNode<
+    Esp8266SerialUart,
+    WiFiServerTransport<VSTP_NETWORK_SERVER_PORT>,
+    VSTP_NODE_RING_BYTES,
+    VSTP_NODE_MAX_PAYLOAD
+> vstp_node_t;
+
+static_assert(sizeof(vstp_node_t) <= VSTP_NODE_RAM_BUDGET,
+              "VSTP node exceeds its RAM budget, see VSTP_NODE_RAM_BUDGET");
+
+static vstp_node_t vstp_node;
 
-int uart_read()
-{
-    return Serial.read();
-}
 
 void setup()
 {
@@ -36,10 +54,12 @@ void setup()
     //}
     //Serial.printf("\nConnected with IP: %s\n", WiFi.localIP().toString().c_str());
 
-    vstp_init(&vstp_state, uart_read);
+    Serial.printf("VSTP node: %u B RAM (%u B ring, %u B max payload)\n",
+                  (unsigned) sizeof(vstp_node), (unsigned) VSTP_NODE_RING_BYTES,
+                  (unsigned) VSTP_NODE_MAX_PAYLOAD);
 }
 
 void loop()
 {
-    vstp_update(&vstp_state);
+    vstp_node.update();
 }
@@ -0,0 +1,124 @@
+#ifndef AGGREGATOR_H
+#define AGGREGATOR_H
+
+#include "stdint.h"
+#include "stddef.h"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "event_loop.h"
+#include "log_sink.h"
+#include "telemetry_receiver.h"
+
+
+// Default time a record may wait for records from slower nodes
+#define AGGREGATOR_REORDER_WINDOW_MS 200
+// Records buffered per node before the oldest is forced out
+#define AGGREGATOR_MAX_BUFFERED      4096
+// How often records are released by the reorder window
+#define AGGREGATOR_TICK_MS           10
+// How often throughput is sampled and metrics are printed
+#define AGGREGATOR_METRICS_MS        5000
+// Window over which the clock offset of a node is re-estimated
+#define AGGREGATOR_OFFSET_WINDOW_MS  1000
+
+
+/*
+ * Merges the streams of several telemetry nodes into one time ordered
+ * stream, in one event loop.
+ *
+ * Each node gets its own receiver and buffer. Node clocks are unrelated, so
+ * every node timestamp is mapped to the host clock with a per node offset,
+ * estimated as the smallest (arrival - timestamp) seen, i.e. the record
+ * with the least link delay. A smaller one is taken at once, and every
+ * AGGREGATOR_OFFSET_WINDOW_MS the offset is set to the smallest of that
+ * window, so it also follows a node clock that runs slower than the host.
+ * Records are then k-way merged on that time:
+ * the oldest buffered record is released when every connected node has a
+ * newer one buffered, or at the latest after the reorder window. Records
+ * that arrive after a newer record has been released are dropped as late,
+ * so the sinks always see non-decreasing time_ms, tagged with the node id.
+ */
+class Aggregator : public LogSink
+{
+public:
+    Aggregator(EventLoop& loop, const uint32_t reorder_window_ms = AGGREGATOR_REORDER_WINDOW_MS);
+    ~Aggregator();
+
+    /* Adds a node, its id is the order it was added in (0, 1, ...) */
+    void add_node(const std::string& ip, const int port);
+    void add_sink(LogSink* sink);
+
+    /*
+     * Records the stream of every node to <prefix>.<node id>.vstp, see
+     * TelemetryReceiver::record(). Returns false if a file could not be opened.
+     */
+    bool record(const std::string& prefix);
+
+    /* Connects to all nodes */
+    void start();
+
+    /* Sends a command to a node, see TelemetryReceiver::send_command() */
+    bool send_command(const uint16_t node_id, const uint8_t cmd);
+
+    /* Called by the node receivers */
+    void on_record(const log_record_t& record) override;
+
+    /* Per node metrics as a JSON array */
+    std::string metrics_json() const;
+    void print_metrics() const;
+
+private:
+    typedef struct
+    {
+        log_record_t record;
+        uint8_t      data[0xFF];
+    } buffered_record_t;
+
+    typedef struct
+    {
+        std::unique_ptr<TelemetryReceiver> receiver;
+        std::deque<buffered_record_t>      buffer;
+
+        // Node clock -> host clock
+        bool     has_offset;
+        int64_t  offset_ms;
+        int64_t  window_offset_ms;
+        uint64_t t0_offset_window_ms;
+        uint32_t last_timestamp;
+
+        // Metrics
+        uint64_t records;
+        uint64_t gaps;
+        uint64_t late;
+        bool     has_last_id;
+        uint32_t last_id;
+        int64_t  last_time_ms;
+        uint64_t sampled_records;
+        uint64_t sampled_bytes;
+        double   records_per_s;
+        double   bytes_per_s;
+    } node_t;
+
+    /* Releases the buffered records that are safe to emit */
+    void merge();
+    void emit(node_t& node);
+    void sample_metrics();
+
+    EventLoop&            loop_;
+    uint32_t              window_ms_;
+    std::vector<node_t>   nodes_;
+    std::vector<LogSink*> sinks_;
+
+    int64_t               last_emitted_ms_;
+    uint64_t              emitted_;
+    uint64_t              last_metrics_us_;
+    int                   tick_timer_;
+    int                   metrics_timer_;
+};
+
+
+#endif /* AGGREGATOR_H */
@@ -0,0 +1,189 @@
+#ifndef DECIMATION_PYRAMID_H
+#define DECIMATION_PYRAMID_H
+
+#include "stdint.h"
+#include "stddef.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "log_sink.h"
+
+
+// Levels of a pyramid: level k buckets hold 2^k samples
+#define PYRAMID_LEVELS           20
+// Levels 1 .. PYRAMID_VIRTUAL_LEVELS are merged from level 0 when queried
+// instead of being stored, which saves most of the memory of the pyramid
+#define PYRAMID_VIRTUAL_LEVELS   3
+// Buckets kept per level of a live series. Must be at least the largest
+// query, so that every level can answer a range it covers in one go.
+#define PYRAMID_CAPACITY         4096
+// Keep every bucket, for recordings that are read in full
+#define PYRAMID_UNBOUNDED        SIZE_MAX
+// Points returned by a query, default and upper limit
+#define PYRAMID_DEFAULT_POINTS   1000
+#define PYRAMID_MAX_POINTS       PYRAMID_CAPACITY
+
+
+typedef struct
+{
+    int64_t  time_ms;   // Time of the first sample in the point
+    float    min;
+    float    max;
+    float    mean;
+    uint32_t samples;   // Merged into the point, fewer than 2^level for a
+                        // bucket that is still filling up
+} pyramid_point_t;
+
+
+/*
+ * Min/max/mean decimation pyramid of a series of samples with a number of
+ * fields each, built incrementally as the samples arrive.
+ *
+ * Level 0 holds the samples, and every bucket of level k + 1 merges two
+ * buckets of level k, so adding a sample costs two bucket merges on
+ * average. The first levels above level 0 are virtual: their buckets are
+ * merged from at most 2^PYRAMID_VIRTUAL_LEVELS samples when queried. Each
+ * level is a ring of at most capacity buckets: level k keeps the last
+ * capacity * 2^k samples, so memory is bounded while the coarse levels
+ * still reach far back in time.
+ *
+ * The buckets that are still filling up are kept per level and are part of
+ * every query, so the newest samples are visible at every level.
+ *
+ * Times must not decrease, an older time is clamped to the newest one.
+ * A NaN value is a missing sample of its field: min and max skip it, and
+ * a mean that has one takes the value of the other side of the merge.
+ */
+class DecimationPyramid
+{
+public:
+    DecimationPyramid(const size_t nbr_of_fields, const size_t capacity = PYRAMID_CAPACITY,
+                      const size_t levels = PYRAMID_LEVELS);
+
+    /* Adds a sample, values holds one value per field */
+    void add(const int64_t time_ms, const float* values);
+
+    /*
+     * Returns at most max_points points of a field over the samples within
+     * [from_ms, to_ms], from the finest level that holds the whole range
+     * in that many points. Returns the level used, -1 if there is no data.
+     * Takes O(levels * log(capacity) + max_points).
+     */
+    int query(const size_t field, const int64_t from_ms, const int64_t to_ms,
+              const size_t max_points, std::vector<pyramid_point_t>& out) const;
+
+    size_t   nbr_of_fields() const { return nbr_of_fields_; }
+    uint64_t samples() const       { return samples_; }
+    int64_t  first_time_ms() const { return first_time_ms_; }
+    int64_t  last_time_ms() const  { return last_time_ms_; }
+    size_t   memory_bytes() const;
+
+    /* Frees unused memory, e.g. once a recording has been read */
+    void shrink_to_fit();
+
+private:
+    typedef struct
+    {
+        int64_t  t_first;
+        int64_t  t_last;
+        uint32_t count;
+        // Per field, empty in level 0 where min = max = mean
+        std::vector<float> min;
+        std::vector<float> max;
+        std::vector<float> mean;
+    } bucket_t;
+
+    typedef struct
+    {
+        // Ring of complete buckets, struct of arrays. Level 0 only uses
+        // t_first and mean, a sample has one time and one value.
+        std::vector<int64_t>  t_first;
+        std::vector<int64_t>  t_last;
+        std::vector<float>    min;
+        std::vector<float>    max;
+        std::vector<float>    mean;
+        size_t                head;     // Physical index of the oldest bucket
+        size_t                size;
+        bool                  evicted;  // True once the oldest bucket was overwritten
+
+        // Bucket that is filling up, from complete buckets of the level below
+        bucket_t              pending;
+    } level_t;
+
+    /* Merges a complete bucket of the level below into the pending bucket of level */
+    void merge_up(const size_t level, const int64_t t_first, const int64_t t_last, const uint32_t count,
+                  const float* min, const float* max, const float* mean);
+    void push(level_t& level, const bucket_t& bucket);
+
+    /* Returns the physical index of the i:th oldest bucket of a level */
+    size_t index(const level_t& level, const size_t i) const
+    {
+        return (level.head + i) % capacity_;
+    }
+    /* Point i of a stored level */
+    void get_point(const size_t level, const size_t i, const size_t field, pyramid_point_t* point) const;
+    /* Merges level 0 buckets [first, end) into one point */
+    void merge_samples(const size_t first, const size_t end, const size_t field, pyramid_point_t* point) const;
+
+    size_t               nbr_of_fields_;
+    size_t               capacity_;
+    std::vector<level_t> levels_;
+
+    uint64_t             samples_;
+    int64_t              first_time_ms_;
+    int64_t              last_time_ms_;
+};
+
+
+/*
+ * Keeps a decimation pyramid per node and log type, of all fields of the
+ * records it receives, e.g. for zooming long recordings in a dashboard.
+ * Times are the time_ms of the records: the host clock behind an
+ * Aggregator, the node clock straight from a TelemetryReceiver. Filtered
+ * blocks are added to the series of their full block, the fields they
+ * don't carry as missing (NaN) values.
+ */
+class PyramidSink : public LogSink
+{
+public:
+    PyramidSink(const size_t capacity = PYRAMID_CAPACITY);
+
+    void on_record(const log_record_t& record) override;
+
+    /*
+     * Answers a range query, e.g. from GET /api/range?<query>:
+     *   field=<name>           Required
+     *   node=<id>              Default 0
+     *   block=<block name>     Default the first block of the node with the field
+     *   from=<ms>, to=<ms>     On the clock of the records, default all data
+     *   n=<points>             Default PYRAMID_DEFAULT_POINTS
+     * Returns false with an error message in out if the query is invalid.
+     */
+    bool query_json(const std::string& query, std::string& out) const;
+
+    /* Series statistics as a JSON array */
+    std::string stats_json() const;
+
+    void shrink_to_fit();
+
+private:
+    typedef struct
+    {
+        uint16_t                           node;
+        uint8_t                            type;
+        const log_field_t*                 fields;
+        std::unique_ptr<DecimationPyramid> pyramid;
+    } series_t;
+
+    struct Adder;
+
+    size_t                  capacity_;
+    // Key is node << 8 | log type
+    std::map<uint32_t, series_t> series_;
+};
+
+
+#endif /* DECIMATION_PYRAMID_H */
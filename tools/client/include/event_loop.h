@@ -0,0 +1,46 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include "stdint.h"
+
+#include <functional>
+#include <unordered_map>
+
+
+/*
+ * Minimal epoll based event loop. All host side networking (receivers,
+ * stream server, aggregator) runs as handlers on one loop, in one thread.
+ */
+class EventLoop
+{
+public:
+    typedef std::function<void(uint32_t events)> fd_handler_t;
+    typedef std::function<void()>                timer_handler_t;
+
+    EventLoop();
+    ~EventLoop();
+
+    /* Registers fd for the given EPOLL* events. Returns false on error. */
+    bool add(const int fd, const uint32_t events, fd_handler_t handler);
+    void modify(const int fd, const uint32_t events);
+    void remove(const int fd);
+
+    /* Calls handler every period_ms. Returns the timer fd, or -1 on error. */
+    int add_timer(const uint32_t period_ms, timer_handler_t handler);
+    void remove_timer(const int timer_fd);
+
+    /* Runs until stop() is called */
+    void run();
+    void stop();
+
+    /* Monotonic time in microseconds */
+    static uint64_t now_us();
+
+private:
+    int  epoll_fd_;
+    bool running_;
+    std::unordered_map<int, fd_handler_t> handlers_;
+};
+
+
+#endif /* EVENT_LOOP_H */
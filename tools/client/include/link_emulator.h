@@ -0,0 +1,208 @@
+#ifndef LINK_EMULATOR_H
+#define LINK_EMULATOR_H
+
+#include "stdint.h"
+#include "stddef.h"
+#include "stdio.h"
+
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "event_loop.h"
+
+
+// Largest packet read from a TCP stream, like a TCP segment over WiFi
+#define LINK_EMULATOR_MSS          1460
+// Default bytes in flight per direction. TCP stops reading from the sender
+// when the window is full, so a slow link backs up into the sender.
+#define LINK_EMULATOR_WINDOW       16384
+// Packets are delivered at this period
+#define LINK_EMULATOR_TICK_MS      1
+// Retransmission timeout of a lost TCP segment, doubled per lost retry.
+// When the last retry is lost too, TCP gives up and drops the connection.
+#define LINK_EMULATOR_MIN_RTO_MS   200
+#define LINK_EMULATOR_MAX_RETRIES  6
+
+
+/* Link conditions of a timeline segment, from t_us until the next one */
+typedef struct
+{
+    uint64_t t_us;              // Start, relative to the start of the emulator
+    bool     up;                // Down: nothing gets through
+    bool     disconnect;        // Closes the connections when the segment starts
+    uint32_t bandwidth_kbps;    // 0 = unlimited
+    uint32_t latency_ms;        // One way
+    uint32_t jitter_ms;         // Uniform in [0, jitter_ms], added to the latency
+    float    loss_pct;          // Packets lost on average
+    float    loss_burst;        // Mean length of a loss burst, in packets
+} link_segment_t;
+
+
+/*
+ * Scripted link conditions, read from a text file with one segment per
+ * line: the start time in seconds, then what changes from there on.
+ * Everything not given is kept from the segment before.
+ *
+ *   # t_s  settings
+ *   0      bw=2000 latency=5 jitter=2
+ *   10     bw=150 loss=2 burst=4
+ *   20     down
+ *   23     up bw=2000 loss=0
+ *   30     disconnect
+ *
+ *   bw=<kbit/s>      Bandwidth, 0 = unlimited
+ *   latency=<ms>     One way latency
+ *   jitter=<ms>      Random extra latency, at most this
+ *   loss=<%>         Packet loss
+ *   burst=<packets>  Mean length of a loss burst, default 1
+ *   down / up        Link outage, e.g. behind a wall
+ *   disconnect       Drops the connections, the link stays up
+ */
+class LinkTimeline
+{
+public:
+    LinkTimeline();
+
+    /* Returns false, printing the offending line, if the file is invalid */
+    bool load(const std::string& path);
+
+    size_t size() const                            { return segments_.size(); }
+    const link_segment_t& segment(size_t i) const  { return segments_[i]; }
+
+    /* Index of the segment in effect at t_us */
+    size_t index_at(const uint64_t t_us) const;
+
+    /* Start of the first up segment at or after t_us, UINT64_MAX if none */
+    uint64_t next_up(const uint64_t t_us) const;
+
+private:
+    std::vector<link_segment_t> segments_;
+};
+
+
+/*
+ * Localhost proxy between a telemetry node (or host_node) and its clients,
+ * that imposes the link conditions of a timeline on the traffic in both
+ * directions.
+ *
+ * Every packet read from one side gets an arrival time at the other side:
+ * it waits for the link to be up and for the packets before it to be sent
+ * at the bandwidth, then takes the latency plus jitter. Loss is decided
+ * per packet by a two state (Gilbert) model, so losses come in bursts.
+ *
+ * The proxy holds one TCP client connection and one connection to the
+ * node, the only transport nodes serve. A lost segment can't be skipped, so it is retransmitted after
+ * the RTO instead, and stalls the stream like it does over WiFi. If all
+ * LINK_EMULATOR_MAX_RETRIES retries are lost too, the segment times out
+ * and the connection is dropped. At most window bytes are in flight per
+ * direction, after that the proxy stops reading and the sender backs up.
+ * Only a dropped connection loses data, what was in flight.
+ *
+ * While the link is down nothing is delivered, packets that were already
+ * on their way are held until it is up again.
+ *
+ * Every packet is logged to the arrivals CSV, see log_arrivals().
+ */
+class LinkEmulator
+{
+public:
+    LinkEmulator(EventLoop& loop, const int listen_port, const std::string& node_ip, const int node_port);
+    ~LinkEmulator();
+
+    void set_timeline(const LinkTimeline& timeline) { timeline_ = timeline; }
+    void set_window(const size_t bytes)             { window_ = bytes; }
+    void set_seed(const uint32_t seed)              { rng_.seed(seed); }
+
+    /*
+     * Writes one row per packet to a CSV file:
+     *   read_us,arrival_us,from,bytes,lost,retransmits,queued_bytes,segment,timeout
+     * Times are CLOCK_MONOTONIC in us, like EventLoop::now_us(), so they
+     * line up with the stats of host_node -s. from is node or client,
+     * arrival_us is empty for lost packets. timeout is 1 for the TCP
+     * segment that ran out of retries and dropped the connection. When a
+     * timeline segment starts there is a row from link, at its start time.
+     * Returns false if the file could not be opened.
+     */
+    bool log_arrivals(const std::string& path);
+
+    /* Returns false if the listening socket could not be opened */
+    bool start();
+
+    /* Prints the statistics of both directions */
+    void print_stats() const;
+
+private:
+    typedef struct
+    {
+        uint64_t             read_us;
+        uint64_t             arrival_us;
+        uint32_t             retransmits;
+        bool                 timed_out;     // All retries lost, arrival_us is when the sender gives up
+        size_t               queued_bytes;  // In flight when read
+        size_t               segment;
+        std::vector<uint8_t> data;
+        size_t               sent;          // Bytes written to the receiver so far
+    } packet_t;
+
+    typedef struct
+    {
+        const char*          from;
+        std::deque<packet_t> queue;
+        size_t               queued_bytes;
+        uint64_t             busy_until_us; // When the link is done sending the queued packets
+        uint64_t             last_arrival_us;
+        bool                 in_burst;
+        bool                 reading;       // Sender fd is registered for EPOLLIN
+
+        uint64_t             packets;
+        uint64_t             bytes;
+        uint64_t             lost;
+        uint64_t             retransmits;
+        uint64_t             timeouts;
+    } direction_t;
+
+    void on_accept();
+    void on_tcp_event(const bool from_node, const uint32_t events);
+    void on_tick();
+    void close_connections();
+    void update_reading(direction_t& dir, const int fd);
+
+    /* Queues data read from a sender, with its arrival time */
+    void send(direction_t& dir, const uint8_t* data, const size_t size);
+    /* Draws the next packet of the loss process */
+    bool is_lost(direction_t& dir, const link_segment_t& link);
+    /*
+     * Writes the packets that have arrived, returns false if fd is gone or
+     * a TCP segment timed out
+     */
+    bool deliver(direction_t& dir, const int fd, const uint64_t now);
+    void log_packet(const direction_t& dir, const packet_t& packet, const bool lost, const bool timeout = false);
+    void log_segment(const uint64_t now, const size_t segment);
+
+    EventLoop&      loop_;
+    int             listen_port_;
+    std::string     node_ip_;
+    int             node_port_;
+
+    LinkTimeline    timeline_;
+    size_t          window_;
+    std::mt19937    rng_;
+    FILE*           arrivals_file_;
+
+    int             listen_fd_;
+    int             client_fd_;
+    int             node_fd_;
+    int             tick_timer_;
+    uint64_t        t0_us_;
+    size_t          segment_;
+
+    direction_t     from_node_;
+    direction_t     from_client_;
+    uint64_t        connections_;
+    uint64_t        disconnects_;
+};
+
+
+#endif /* LINK_EMULATOR_H */
@@ -0,0 +1,18 @@
+#ifndef LOG_JSON_H
+#define LOG_JSON_H
+
+#include <string>
+
+#include "log_sink.h"
+
+
+/*
+ * Appends the record as a single line JSON object to out:
+ * {"node":0,"time":1,"type":"control_loop","timestamp":1,"id":2,"data":{"raw_gyro_x":0.5,...}}
+ * Field names and types come from the log schema. A filtered block is named
+ * after its full block and only has the fields it carried.
+ */
+void log_record_to_json(const log_record_t& record, std::string& out);
+
+
+#endif /* LOG_JSON_H */
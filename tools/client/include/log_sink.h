@@ -0,0 +1,37 @@
+#ifndef LOG_SINK_H
+#define LOG_SINK_H
+
+#include "stdint.h"
+#include "stddef.h"
+
+#include "log_schema.h"
+
+
+/*
+ * One decoded log block, as handed from a receiver to its sinks.
+ * data points to the raw data struct of header.type and is only valid
+ * during the on_record() call.
+ * time_ms is the node timestamp on the host clock when merged from several
+ * nodes (see Aggregator), and header.timestamp otherwise.
+ */
+typedef struct
+{
+    uint16_t           node;
+    int64_t            time_ms;
+    log_block_header_t header;
+    const uint8_t*     data;
+    size_t             size;
+} log_record_t;
+
+/*
+ * Something that consumes log records, e.g. the stream server.
+ */
+class LogSink
+{
+public:
+    virtual ~LogSink() {}
+    virtual void on_record(const log_record_t& record) = 0;
+};
+
+
+#endif /* LOG_SINK_H */
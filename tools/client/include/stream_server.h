@@ -0,0 +1,132 @@
+#ifndef STREAM_SERVER_H
+#define STREAM_SERVER_H
+
+#include "stdint.h"
+#include "stddef.h"
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "event_loop.h"
+#include "log_sink.h"
+
+
+// Decoded frames kept in the shared ingest ring, for all clients
+#define STREAM_SERVER_MAX_FRAMES    4096
+// Clients are flushed at this period, so writes are batched per client
+#define STREAM_SERVER_TICK_MS       20
+// Largest accepted HTTP request head
+#define STREAM_SERVER_REQUEST_MAX   4096
+// Unsent bytes a client may have before we drop its frames
+#define STREAM_SERVER_MAX_PENDING   (256 * 1024)
+#define STREAM_SERVER_MAX_CLIENTS   256
+// Default per client rate limit, in frames per second (0 = unlimited)
+#define STREAM_SERVER_DEFAULT_HZ    50
+
+
+/*
+ * Event driven HTTP server that streams log records to browser dashboards.
+ *
+ * Each record is encoded to JSON once, into a shared ring of frames. Every
+ * client has a cursor into the ring and a rate limit, and on every tick
+ * gets the frames since its cursor in one chunked write, decimated to its
+ * rate. A client that can't keep up, i.e. falls behind the ring or has
+ * STREAM_SERVER_MAX_PENDING unsent bytes, skips frames instead of queueing.
+ *
+ * Endpoints:
+ *   GET /api/stream[?hz=N]  Server-sent events (chunked), one record per event
+ *   GET /api/stats          Server and client statistics as JSON
+ * and the JSON endpoints added with add_endpoint().
+ */
+class StreamServer : public LogSink
+{
+public:
+    StreamServer(EventLoop& loop, const int port);
+    ~StreamServer();
+
+    /* Returns false if the server socket could not be opened */
+    bool start();
+
+    void on_record(const log_record_t& record) override;
+
+    /* Adds a JSON member to /api/stats, e.g. "nodes":[...] */
+    void add_stats(const std::string& name, std::function<std::string()> provider);
+
+    /*
+     * Serves GET <path>?<query> with handler(query, body), which returns
+     * false with an error message in body for 400 Bad Request.
+     */
+    typedef std::function<bool(const std::string& query, std::string& body)> endpoint_t;
+    void add_endpoint(const std::string& path, endpoint_t handler);
+
+    /* Sets value to the value of name in a URL query, returns false if not there */
+    static bool query_param(const std::string& query, const char* name, std::string& value);
+
+private:
+    enum client_state_t
+    {
+        CLIENT_READING_REQUEST,
+        CLIENT_STREAMING,
+        CLIENT_CLOSING
+    };
+
+    typedef struct
+    {
+        int            fd;
+        client_state_t state;
+        std::string    request;
+
+        // Unsent output
+        std::string    out;
+        size_t         out_sent;
+
+        // Streaming
+        uint64_t       next_seq;
+        double         hz;
+        double         tokens;
+        uint64_t       frames_sent;
+        uint64_t       frames_dropped;
+    } client_t;
+
+    typedef struct
+    {
+        uint64_t    seq;
+        std::string json;
+    } frame_t;
+
+    void on_accept();
+    void on_client_event(const int fd, const uint32_t events);
+    void handle_client_event(client_t& client, const uint32_t events);
+    void handle_request(client_t& client);
+    void respond(client_t& client, const char* status, const char* content_type, const std::string& body);
+    void flush_clients();
+    void flush_client(client_t& client, const double dt);
+    void send_pending(client_t& client);
+    /*
+     * Closes the socket and sets fd to -1. The client is forgotten by the
+     * caller of the handler, after the event or the flush, so the client
+     * stays valid for whoever is using it.
+     */
+    void close_client(client_t& client);
+    std::string stats_json() const;
+
+    EventLoop&                        loop_;
+    int                               port_;
+    int                               server_fd_;
+    int                               tick_timer_;
+    uint64_t                          last_tick_us_;
+
+    std::vector<frame_t>              frames_;
+    uint64_t                          next_seq_;
+
+    std::unordered_map<int, client_t> clients_;
+    uint64_t                          clients_total_;
+
+    std::vector<std::pair<std::string, std::function<std::string()>>> stats_;
+    std::unordered_map<std::string, endpoint_t>                      endpoints_;
+};
+
+
+#endif /* STREAM_SERVER_H */
@@ -0,0 +1,84 @@
+#ifndef TELEMETRY_RECEIVER_H
+#define TELEMETRY_RECEIVER_H
+
+#include "stdint.h"
+#include "stddef.h"
+#include "stdio.h"
+
+#include <string>
+#include <vector>
+
+#include "event_loop.h"
+#include "log_sink.h"
+
+
+#define TELEMETRY_RECEIVER_BUF_SIZE       (64 * 1024)
+#define TELEMETRY_RECEIVER_RETRY_DELAY_MS 1000
+
+
+/*
+ * Connects to a telemetry node, splits its stream into log blocks using the
+ * log schema and hands each block to the sinks. Reconnects automatically.
+ */
+class TelemetryReceiver
+{
+public:
+    TelemetryReceiver(EventLoop& loop, const std::string& ip, const int port, const uint16_t node_id);
+    ~TelemetryReceiver();
+
+    void add_sink(LogSink* sink);
+
+    /* Starts connecting to the node, in the background of the event loop */
+    void start();
+
+    /* Parses raw node stream bytes, e.g. from a saved recording */
+    void feed(const uint8_t* data, size_t size);
+
+    /*
+     * Appends every received log block to a file, which can be fed back
+     * later. Returns false if the file could not be opened.
+     */
+    bool record(const std::string& path);
+
+    /*
+     * Sends a VSTP command without payload to the node, over the connection
+     * it streams on, e.g. VSTP_CMD_PROFILE_DUMP. Returns false if not connected.
+     */
+    bool send_command(const uint8_t cmd);
+
+    const std::string& ip() const  { return ip_; }
+    int      port() const          { return port_; }
+    uint16_t node_id() const       { return node_id_; }
+    bool     connected() const     { return connected_; }
+    uint64_t bytes_received() const { return bytes_received_; }
+    uint64_t records() const       { return records_; }
+    uint64_t parse_errors() const  { return parse_errors_; }
+
+private:
+    void try_connect();
+    void on_socket_event(const uint32_t events);
+    void close_socket();
+    void parse();
+
+    EventLoop&            loop_;
+    std::string           ip_;
+    int                   port_;
+    uint16_t              node_id_;
+    std::vector<LogSink*> sinks_;
+
+    int                   sockfd_;
+    bool                  connected_;
+    int                   retry_timer_;
+
+    FILE*                 record_file_;
+
+    uint8_t               buf_[TELEMETRY_RECEIVER_BUF_SIZE];
+    size_t                buf_size_;
+
+    uint64_t              bytes_received_;
+    uint64_t              records_;
+    uint64_t              parse_errors_;
+};
+
+
+#endif /* TELEMETRY_RECEIVER_H */
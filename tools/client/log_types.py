@@ -1,3 +1,5 @@
+# Generated by tools/gen_log_types.py from include/log_schema_def.h.
+# Do not edit by hand, run `make -C tools/client log_types` instead.
 from dataclasses import dataclass, fields
 import struct
 from enum import IntEnum
@@ -9,15 +11,42 @@ class log_block_t:
 class log_type_t(IntEnum):
     LOG_TYPE_PID = 0
     LOG_TYPE_BATTERY = 1
+    LOG_TYPE_PID_SUMMARY = 2
+    LOG_TYPE_LINK_MODE = 3
+    LOG_TYPE_PROFILE = 4
+    LOG_TYPE_PID_FILTERED = 5
+
+class log_summary_stat_t(IntEnum):
+    LOG_SUMMARY_MIN = 0
+    LOG_SUMMARY_MAX = 1
+    LOG_SUMMARY_MEAN = 2
+    LOG_SUMMARY_LAST = 3
+
+class log_link_mode_t(IntEnum):
+    LOG_LINK_MODE_FULL_RATE = 0
+    LOG_LINK_MODE_SUMMARY = 1
+
+class log_profile_phase_t(IntEnum):
+    LOG_PROFILE_PHASE_UART = 0
+    LOG_PROFILE_PHASE_POLL = 1
+    LOG_PROFILE_PHASE_UPSTREAM_RX = 2
+    LOG_PROFILE_PHASE_LINK = 3
+    LOG_PROFILE_PHASE_DEBUG = 4
+    LOG_PROFILE_PHASE_RING = 5
+    LOG_PROFILE_PHASE_WRITE = 6
+    LOG_PROFILE_PHASE_BUSY = 7
+    LOG_PROFILE_PHASE_IDLE = 8
+    LOG_PROFILE_PHASE_OUTSIDE = 9
 
 @dataclass
 class log_block_header_t(log_block_t):
-    type: float = 0 # log_type_t
+    type: float = 0 # uint8_t
     timestamp: float = 0 # uint32_t
     id: float = 0 # uint32_t
 
     fmt = '<BII'
     size = struct.calcsize(fmt)
+    names = ('type', 'timestamp', 'id')
 
     def to_bytes(self) -> bytes:
         """ Returns a log_block_header_t in bytes. """
@@ -25,6 +54,8 @@ class log_block_header_t(log_block_t):
         raw = struct.pack(fmt, *[getattr(self, f.name) for f in fields(self)])
         return raw
 
+assert log_block_header_t.size == 9
+
 @dataclass
 class log_block_data_control_loop_t(log_block_header_t):
     raw_gyro_x: float = 0 # float
@@ -77,6 +108,7 @@ class log_block_data_control_loop_t(log_block_header_t):
 
     fmt = '<ffffffHHHHffff???ffffffffffffffffffffffffffffff'
     size = struct.calcsize(fmt)
+    names = ('raw_gyro_x', 'raw_gyro_y', 'raw_gyro_z', 'filtered_gyro_x', 'filtered_gyro_y', 'filtered_gyro_z', 'rc_in_roll', 'rc_in_pitch', 'rc_in_yaw', 'rc_in_throttle', 'setpoint_roll', 'setpoint_pitch', 'setpoint_yaw', 'setpoint_throttle', 'is_connected', 'is_armed', 'can_run_motors', 'roll_error', 'roll_error_integral', 'roll_p', 'roll_i', 'roll_d', 'roll_pid', 'roll_adjust', 'pitch_error', 'pitch_error_integral', 'pitch_p', 'pitch_i', 'pitch_d', 'pitch_pid', 'pitch_adjust', 'yaw_error', 'yaw_error_integral', 'yaw_p', 'yaw_i', 'yaw_d', 'yaw_pid', 'yaw_adjust', 'm1_non_restricted', 'm2_non_restricted', 'm3_non_restricted', 'm4_non_restricted', 'm1_restricted', 'm2_restricted', 'm3_restricted', 'm4_restricted', 'battery')
 
     def to_bytes(self) -> bytes:
         """ Returns a log_block_data_control_loop_t in bytes. """
@@ -85,12 +117,15 @@ class log_block_data_control_loop_t(log_block_header_t):
         raw = struct.pack(fmt, *[getattr(self, f.name) for f in fields(self)])
         return raw
 
+assert log_block_data_control_loop_t.size == 171
+
 @dataclass
 class log_block_data_battery_t(log_block_header_t):
     voltage: float = 0 # float
 
     fmt = '<f'
     size = struct.calcsize(fmt)
+    names = ('voltage',)
 
     def to_bytes(self) -> bytes:
         """ Returns a log_block_data_battery_t in bytes. """
@@ -99,3 +134,172 @@ class log_block_data_battery_t(log_block_header_t):
         raw = struct.pack(fmt, *[getattr(self, f.name) for f in fields(self)])
         return raw
 
+assert log_block_data_battery_t.size == 4
+
+@dataclass
+class log_block_data_control_loop_summary_t(log_block_header_t):
+    stat: float = 0 # uint8_t
+    samples: float = 0 # uint16_t
+    window_start: float = 0 # uint32_t
+    raw_gyro_x: float = 0 # float
+    raw_gyro_y: float = 0 # float
+    raw_gyro_z: float = 0 # float
+    filtered_gyro_x: float = 0 # float
+    filtered_gyro_y: float = 0 # float
+    filtered_gyro_z: float = 0 # float
+    rc_in_roll: float = 0 # uint16_t
+    rc_in_pitch: float = 0 # uint16_t
+    rc_in_yaw: float = 0 # uint16_t
+    rc_in_throttle: float = 0 # uint16_t
+    setpoint_roll: float = 0 # float
+    setpoint_pitch: float = 0 # float
+    setpoint_yaw: float = 0 # float
+    setpoint_throttle: float = 0 # float
+    is_connected: float = 0 # bool
+    is_armed: float = 0 # bool
+    can_run_motors: float = 0 # bool
+    roll_error: float = 0 # float
+    roll_error_integral: float = 0 # float
+    roll_p: float = 0 # float
+    roll_i: float = 0 # float
+    roll_d: float = 0 # float
+    roll_pid: float = 0 # float
+    roll_adjust: float = 0 # float
+    pitch_error: float = 0 # float
+    pitch_error_integral: float = 0 # float
+    pitch_p: float = 0 # float
+    pitch_i: float = 0 # float
+    pitch_d: float = 0 # float
+    pitch_pid: float = 0 # float
+    pitch_adjust: float = 0 # float
+    yaw_error: float = 0 # float
+    yaw_error_integral: float = 0 # float
+    yaw_p: float = 0 # float
+    yaw_i: float = 0 # float
+    yaw_d: float = 0 # float
+    yaw_pid: float = 0 # float
+    yaw_adjust: float = 0 # float
+    m1_non_restricted: float = 0 # float
+    m2_non_restricted: float = 0 # float
+    m3_non_restricted: float = 0 # float
+    m4_non_restricted: float = 0 # float
+    m1_restricted: float = 0 # float
+    m2_restricted: float = 0 # float
+    m3_restricted: float = 0 # float
+    m4_restricted: float = 0 # float
+    battery: float = 0 # float
+
+    fmt = '<BHIffffffHHHHffff???ffffffffffffffffffffffffffffff'
+    size = struct.calcsize(fmt)
+    names = ('stat', 'samples', 'window_start', 'raw_gyro_x', 'raw_gyro_y', 'raw_gyro_z', 'filtered_gyro_x', 'filtered_gyro_y', 'filtered_gyro_z', 'rc_in_roll', 'rc_in_pitch', 'rc_in_yaw', 'rc_in_throttle', 'setpoint_roll', 'setpoint_pitch', 'setpoint_yaw', 'setpoint_throttle', 'is_connected', 'is_armed', 'can_run_motors', 'roll_error', 'roll_error_integral', 'roll_p', 'roll_i', 'roll_d', 'roll_pid', 'roll_adjust', 'pitch_error', 'pitch_error_integral', 'pitch_p', 'pitch_i', 'pitch_d', 'pitch_pid', 'pitch_adjust', 'yaw_error', 'yaw_error_integral', 'yaw_p', 'yaw_i', 'yaw_d', 'yaw_pid', 'yaw_adjust', 'm1_non_restricted', 'm2_non_restricted', 'm3_non_restricted', 'm4_non_restricted', 'm1_restricted', 'm2_restricted', 'm3_restricted', 'm4_restricted', 'battery')
+
+    def to_bytes(self) -> bytes:
+        """ Returns a log_block_data_control_loop_summary_t in bytes. """
+        fmt = self.fmt
+        fmt = super().fmt + fmt.replace("<", "")
+        raw = struct.pack(fmt, *[getattr(self, f.name) for f in fields(self)])
+        return raw
+
+assert log_block_data_control_loop_summary_t.size == 178
+
+@dataclass
+class log_block_data_link_mode_t(log_block_header_t):
+    mode: float = 0 # uint8_t
+    ring_used: float = 0 # uint16_t
+    ring_size: float = 0 # uint16_t
+    drain_rate: float = 0 # uint32_t
+    input_rate: float = 0 # uint32_t
+    discarded_packets: float = 0 # uint16_t
+
+    fmt = '<BHHIIH'
+    size = struct.calcsize(fmt)
+    names = ('mode', 'ring_used', 'ring_size', 'drain_rate', 'input_rate', 'discarded_packets')
+
+    def to_bytes(self) -> bytes:
+        """ Returns a log_block_data_link_mode_t in bytes. """
+        fmt = self.fmt
+        fmt = super().fmt + fmt.replace("<", "")
+        raw = struct.pack(fmt, *[getattr(self, f.name) for f in fields(self)])
+        return raw
+
+assert log_block_data_link_mode_t.size == 15
+
+@dataclass
+class log_block_data_profile_phase_t(log_block_header_t):
+    phase: float = 0 # uint8_t
+    calls: float = 0 # uint32_t
+    total_cycles: float = 0 # uint64_t
+    max_cycles: float = 0 # uint32_t
+    cycles_per_us: float = 0 # uint16_t
+    elapsed_ms: float = 0 # uint32_t
+    listen_restarts: float = 0 # uint32_t
+    hist_0: float = 0 # uint32_t
+    hist_1: float = 0 # uint32_t
+    hist_2: float = 0 # uint32_t
+    hist_3: float = 0 # uint32_t
+    hist_4: float = 0 # uint32_t
+    hist_5: float = 0 # uint32_t
+    hist_6: float = 0 # uint32_t
+    hist_7: float = 0 # uint32_t
+    hist_8: float = 0 # uint32_t
+    hist_9: float = 0 # uint32_t
+    hist_10: float = 0 # uint32_t
+    hist_11: float = 0 # uint32_t
+    hist_12: float = 0 # uint32_t
+    hist_13: float = 0 # uint32_t
+    hist_14: float = 0 # uint32_t
+    hist_15: float = 0 # uint32_t
+
+    fmt = '<BIQIHIIIIIIIIIIIIIIIIII'
+    size = struct.calcsize(fmt)
+    names = ('phase', 'calls', 'total_cycles', 'max_cycles', 'cycles_per_us', 'elapsed_ms', 'listen_restarts', 'hist_0', 'hist_1', 'hist_2', 'hist_3', 'hist_4', 'hist_5', 'hist_6', 'hist_7', 'hist_8', 'hist_9', 'hist_10', 'hist_11', 'hist_12', 'hist_13', 'hist_14', 'hist_15')
+
+    def to_bytes(self) -> bytes:
+        """ Returns a log_block_data_profile_phase_t in bytes. """
+        fmt = self.fmt
+        fmt = super().fmt + fmt.replace("<", "")
+        raw = struct.pack(fmt, *[getattr(self, f.name) for f in fields(self)])
+        return raw
+
+assert log_block_data_profile_phase_t.size == 91
+
+@dataclass
+class log_block_data_control_loop_filtered_t(log_block_header_t):
+    field_mask: float = 0 # uint64_t
+
+    fmt = '<Q'
+    size = struct.calcsize(fmt)
+    names = ('field_mask',)
+
+    def to_bytes(self) -> bytes:
+        """ Returns a log_block_data_control_loop_filtered_t in bytes. """
+        fmt = self.fmt
+        fmt = super().fmt + fmt.replace("<", "")
+        raw = struct.pack(fmt, *[getattr(self, f.name) for f in fields(self)])
+        return raw
+
+assert log_block_data_control_loop_filtered_t.size == 8
+
+# Log type -> data class, for decoding a stream of log blocks
+LOG_BLOCK_TYPES = {
+    log_type_t.LOG_TYPE_PID: log_block_data_control_loop_t,
+    log_type_t.LOG_TYPE_BATTERY: log_block_data_battery_t,
+    log_type_t.LOG_TYPE_PID_SUMMARY: log_block_data_control_loop_summary_t,
+    log_type_t.LOG_TYPE_LINK_MODE: log_block_data_link_mode_t,
+    log_type_t.LOG_TYPE_PROFILE: log_block_data_profile_phase_t,
+    log_type_t.LOG_TYPE_PID_FILTERED: log_block_data_control_loop_filtered_t,
+}
+
+# Log type of a filtered block -> data class of its full block. A filtered
+# block is followed by the fields of its field_mask, see filtered_fmt().
+LOG_BLOCK_FILTERED = {
+    log_type_t.LOG_TYPE_PID_FILTERED: log_block_data_control_loop_t,
+}
+
+def filtered_fmt(block: type, field_mask: int) -> str:
+    """ Returns the struct format of the fields of block in field_mask. """
+    return '<' + ''.join(c for i, c in enumerate(block.fmt[1:]) if field_mask & (1 << i))
+
+def filtered_names(block: type, field_mask: int) -> tuple:
+    """ Returns the names of the fields of block in field_mask. """
+    return tuple(name for i, name in enumerate(block.names) if field_mask & (1 << i))
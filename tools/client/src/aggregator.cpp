@@ -0,0 +1,263 @@
+#include "aggregator.h"
+
+#include "stdio.h"
+#include "string.h"
+#include "inttypes.h"
+
+
+Aggregator::Aggregator(EventLoop& loop, const uint32_t reorder_window_ms)
+    : loop_(loop),
+      window_ms_(reorder_window_ms),
+      last_emitted_ms_(INT64_MIN),
+      emitted_(0),
+      last_metrics_us_(0),
+      tick_timer_(-1),
+      metrics_timer_(-1)
+{
+}
+
+Aggregator::~Aggregator()
+{
+    if (tick_timer_ != -1)
+    {
+        loop_.remove_timer(tick_timer_);
+    }
+    if (metrics_timer_ != -1)
+    {
+        loop_.remove_timer(metrics_timer_);
+    }
+}
+
+void Aggregator::add_node(const std::string& ip, const int port)
+{
+    node_t node = node_t();
+    node.receiver.reset(new TelemetryReceiver(loop_, ip, port, nodes_.size()));
+    node.receiver->add_sink(this);
+    nodes_.push_back(std::move(node));
+}
+
+void Aggregator::add_sink(LogSink* sink)
+{
+    sinks_.push_back(sink);
+}
+
+bool Aggregator::record(const std::string& prefix)
+{
+    for (size_t i = 0; i < nodes_.size(); i++)
+    {
+        if (!nodes_[i].receiver->record(prefix + "." + std::to_string(i) + ".vstp"))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Aggregator::start()
+{
+    for (node_t& node : nodes_)
+    {
+        node.receiver->start();
+    }
+
+    last_metrics_us_ = EventLoop::now_us();
+    tick_timer_ = loop_.add_timer(AGGREGATOR_TICK_MS, [this]() { merge(); });
+    metrics_timer_ = loop_.add_timer(AGGREGATOR_METRICS_MS, [this]() { sample_metrics(); });
+}
+
+bool Aggregator::send_command(const uint16_t node_id, const uint8_t cmd)
+{
+    return (node_id < nodes_.size()) && nodes_[node_id].receiver->send_command(cmd);
+}
+
+void Aggregator::on_record(const log_record_t& record)
+{
+    node_t& node = nodes_[record.node];
+    const uint64_t arrival_ms = EventLoop::now_us() / 1000;
+    const uint32_t timestamp = record.header.timestamp;
+
+    // Node clock went backwards beyond the window, e.g. the FC rebooted
+    if (node.has_offset && ((uint64_t) timestamp + window_ms_ < node.last_timestamp))
+    {
+        node.has_offset = false;
+        node.has_last_id = false;
+    }
+
+    const int64_t offset = (int64_t) arrival_ms - timestamp;
+    if (!node.has_offset)
+    {
+        node.offset_ms = offset;
+        node.window_offset_ms = offset;
+        node.t0_offset_window_ms = arrival_ms;
+        node.has_offset = true;
+    }
+    if (offset < node.offset_ms)
+    {
+        node.offset_ms = offset;
+    }
+    if (offset < node.window_offset_ms)
+    {
+        node.window_offset_ms = offset;
+    }
+    if ((arrival_ms - node.t0_offset_window_ms) >= AGGREGATOR_OFFSET_WINDOW_MS)
+    {   // Lets the offset grow again, for a node clock slower than ours
+        node.offset_ms = node.window_offset_ms;
+        node.window_offset_ms = offset;
+        node.t0_offset_window_ms = arrival_ms;
+    }
+
+    // Metrics
+    if (node.has_last_id && (record.header.id > node.last_id + 1))
+    {
+        node.gaps += record.header.id - node.last_id - 1;
+    }
+    node.last_id = record.header.id;
+    node.has_last_id = true;
+    node.last_timestamp = timestamp;
+    node.last_time_ms = timestamp + node.offset_ms;
+    node.records++;
+
+    if (node.last_time_ms < last_emitted_ms_)
+    {   // A newer record has already been released
+        node.late++;
+        return;
+    }
+
+    if (node.buffer.size() >= AGGREGATOR_MAX_BUFFERED)
+    {   // Make room, the other nodes are too far behind
+        emit(node);
+    }
+
+    node.buffer.emplace_back();
+    buffered_record_t& buffered = node.buffer.back();
+    buffered.record = record;
+    buffered.record.time_ms = node.last_time_ms;
+    memcpy(buffered.data, record.data, record.size);
+
+    merge();
+}
+
+void Aggregator::merge()
+{
+    const int64_t release_ms = (int64_t) (EventLoop::now_us() / 1000) - window_ms_;
+
+    while (1)
+    {
+        // Node with the oldest buffered record, and whether every
+        // connected node has something buffered
+        node_t* oldest = NULL;
+        bool all_buffered = true;
+
+        for (node_t& node : nodes_)
+        {
+            if (node.buffer.empty())
+            {
+                if (node.receiver->connected())
+                {
+                    all_buffered = false;
+                }
+                continue;
+            }
+            if ((oldest == NULL) || (node.buffer.front().record.time_ms < oldest->buffer.front().record.time_ms))
+            {
+                oldest = &node;
+            }
+        }
+
+        if (oldest == NULL)
+        {
+            return;
+        }
+
+        if (!all_buffered && (oldest->buffer.front().record.time_ms > release_ms))
+        {   // A slower node may still deliver something older
+            return;
+        }
+
+        emit(*oldest);
+    }
+}
+
+void Aggregator::emit(node_t& node)
+{
+    buffered_record_t& buffered = node.buffer.front();
+    buffered.record.data = buffered.data;
+
+    if (buffered.record.time_ms < last_emitted_ms_)
+    {   // Only when forced out of a full buffer
+        node.late++;
+    }
+    else
+    {
+        for (LogSink* sink : sinks_)
+        {
+            sink->on_record(buffered.record);
+        }
+        last_emitted_ms_ = buffered.record.time_ms;
+        emitted_++;
+    }
+
+    node.buffer.pop_front();
+}
+
+void Aggregator::sample_metrics()
+{
+    const uint64_t now = EventLoop::now_us();
+    const double dt = (now - last_metrics_us_) / 1e6;
+    last_metrics_us_ = now;
+
+    for (node_t& node : nodes_)
+    {
+        const uint64_t bytes = node.receiver->bytes_received();
+        node.records_per_s = (node.records - node.sampled_records) / dt;
+        node.bytes_per_s = (bytes - node.sampled_bytes) / dt;
+        node.sampled_records = node.records;
+        node.sampled_bytes = bytes;
+    }
+
+    print_metrics();
+}
+
+std::string Aggregator::metrics_json() const
+{
+    const int64_t now_ms = EventLoop::now_us() / 1000;
+    std::string json = "[";
+    char buf[512];
+
+    for (size_t i = 0; i < nodes_.size(); i++)
+    {
+        const node_t& node = nodes_[i];
+        // Age of the newest data from the node, on the host clock
+        const int64_t lag_ms = node.has_offset ? (now_ms - node.last_time_ms) : -1;
+
+        snprintf(buf, sizeof(buf),
+            "%s{\"node\":%zu,\"address\":\"%s:%d\",\"connected\":%s,\"records\":%" PRIu64 ","
+            "\"records_per_s\":%.1f,\"bytes_per_s\":%.0f,\"lag_ms\":%" PRId64 ",\"gaps\":%" PRIu64 ","
+            "\"late\":%" PRIu64 ",\"buffered\":%zu,\"parse_errors\":%" PRIu64 "}",
+            (i > 0) ? "," : "", i, node.receiver->ip().c_str(), node.receiver->port(),
+            node.receiver->connected() ? "true" : "false", node.records,
+            node.records_per_s, node.bytes_per_s, lag_ms, node.gaps,
+            node.late, node.buffer.size(), node.receiver->parse_errors());
+        json.append(buf);
+    }
+
+    json.append("]");
+    return json;
+}
+
+void Aggregator::print_metrics() const
+{
+    const int64_t now_ms = EventLoop::now_us() / 1000;
+
+    for (size_t i = 0; i < nodes_.size(); i++)
+    {
+        const node_t& node = nodes_[i];
+        const int64_t lag_ms = node.has_offset ? (now_ms - node.last_time_ms) : -1;
+
+        printf("Node %zu (%s:%d) %s: %.0f rec/s, %.1f kB/s, lag: %" PRId64 " ms, gaps: %" PRIu64 ", late: %" PRIu64 ", buffered: %zu\n",
+               i, node.receiver->ip().c_str(), node.receiver->port(),
+               node.receiver->connected() ? "up" : "down",
+               node.records_per_s, node.bytes_per_s / 1000, lag_ms, node.gaps, node.late, node.buffer.size());
+    }
+    fflush(stdout);
+}
@@ -0,0 +1,513 @@
+#include "decimation_pyramid.h"
+#include "stream_server.h"
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "math.h"
+#include "inttypes.h"
+
+#include <algorithm>
+
+
+// -- DecimationPyramid -- //
+
+/* Weighted mean of two buckets, where a missing (NaN) side takes the other */
+static inline float merge_mean(const float a, const float b, const float w_a)
+{
+    if (isnan(a))
+    {
+        return b;
+    }
+    if (isnan(b))
+    {
+        return a;
+    }
+    return a * w_a + b * (1 - w_a);
+}
+
+DecimationPyramid::DecimationPyramid(const size_t nbr_of_fields, const size_t capacity, const size_t levels)
+    : nbr_of_fields_(nbr_of_fields),
+      capacity_(capacity),
+      levels_(levels),
+      samples_(0),
+      first_time_ms_(0),
+      last_time_ms_(0)
+{
+    for (level_t& level : levels_)
+    {
+        level.head = 0;
+        level.size = 0;
+        level.evicted = false;
+        level.pending.count = 0;
+    }
+}
+
+void DecimationPyramid::add(const int64_t time_ms, const float* values)
+{
+    int64_t t = time_ms;
+    if (samples_ == 0)
+    {
+        first_time_ms_ = t;
+    }
+    else if (t < last_time_ms_)
+    {
+        t = last_time_ms_;
+    }
+    last_time_ms_ = t;
+    samples_++;
+
+    // Level 0 holds the samples as they are
+    level_t& raw = levels_[0];
+    if (raw.size < capacity_)
+    {
+        raw.t_first.push_back(t);
+        raw.mean.insert(raw.mean.end(), values, values + nbr_of_fields_);
+        raw.size++;
+    }
+    else
+    {
+        raw.t_first[raw.head] = t;
+        memcpy(&raw.mean[raw.head * nbr_of_fields_], values, nbr_of_fields_ * sizeof(float));
+        raw.head = (raw.head + 1) % capacity_;
+        raw.evicted = true;
+    }
+
+    merge_up(PYRAMID_VIRTUAL_LEVELS + 1, t, t, 1, values, values, values);
+}
+
+void DecimationPyramid::merge_up(const size_t level, const int64_t t_first, const int64_t t_last, const uint32_t count,
+                                 const float* min, const float* max, const float* mean)
+{
+    if (level >= levels_.size())
+    {
+        return;
+    }
+
+    bucket_t& pending = levels_[level].pending;
+
+    if (pending.count == 0)
+    {
+        pending.t_first = t_first;
+        pending.min.assign(min, min + nbr_of_fields_);
+        pending.max.assign(max, max + nbr_of_fields_);
+        pending.mean.assign(mean, mean + nbr_of_fields_);
+    }
+    else
+    {
+        const float w_old = (float) pending.count / (pending.count + count);
+        for (size_t f = 0; f < nbr_of_fields_; f++)
+        {
+            pending.min[f] = fminf(pending.min[f], min[f]);
+            pending.max[f] = fmaxf(pending.max[f], max[f]);
+            pending.mean[f] = merge_mean(pending.mean[f], mean[f], w_old);
+        }
+    }
+    pending.t_last = t_last;
+    pending.count += count;
+
+    if (pending.count == (1u << level))
+    {
+        push(levels_[level], pending);
+        merge_up(level + 1, pending.t_first, pending.t_last, pending.count,
+                 pending.min.data(), pending.max.data(), pending.mean.data());
+        pending.count = 0;
+    }
+}
+
+void DecimationPyramid::push(level_t& level, const bucket_t& bucket)
+{
+    if (level.size < capacity_)
+    {
+        level.t_first.push_back(bucket.t_first);
+        level.t_last.push_back(bucket.t_last);
+        level.min.insert(level.min.end(), bucket.min.begin(), bucket.min.end());
+        level.max.insert(level.max.end(), bucket.max.begin(), bucket.max.end());
+        level.mean.insert(level.mean.end(), bucket.mean.begin(), bucket.mean.end());
+        level.size++;
+        return;
+    }
+
+    const size_t at = level.head * nbr_of_fields_;
+    level.t_first[level.head] = bucket.t_first;
+    level.t_last[level.head] = bucket.t_last;
+    std::copy(bucket.min.begin(), bucket.min.end(), level.min.begin() + at);
+    std::copy(bucket.max.begin(), bucket.max.end(), level.max.begin() + at);
+    std::copy(bucket.mean.begin(), bucket.mean.end(), level.mean.begin() + at);
+    level.head = (level.head + 1) % capacity_;
+    level.evicted = true;
+}
+
+void DecimationPyramid::get_point(const size_t level, const size_t i, const size_t field,
+                                  pyramid_point_t* point) const
+{
+    const level_t& l = levels_[level];
+    const size_t at = index(l, i);
+    const size_t value = at * nbr_of_fields_ + field;
+
+    point->time_ms = l.t_first[at];
+    point->min = l.min[value];
+    point->max = l.max[value];
+    point->mean = l.mean[value];
+    point->samples = 1u << level;
+}
+
+void DecimationPyramid::merge_samples(const size_t first, const size_t end, const size_t field,
+                                      pyramid_point_t* point) const
+{
+    const level_t& raw = levels_[0];
+    double sum = 0;
+    size_t count = 0;
+
+    point->time_ms = raw.t_first[index(raw, first)];
+    point->min = NAN;
+    point->max = NAN;
+
+    for (size_t i = first; i < end; i++)
+    {
+        const float value = raw.mean[index(raw, i) * nbr_of_fields_ + field];
+        if (isnan(value))
+        {
+            continue;
+        }
+        point->min = fminf(point->min, value);
+        point->max = fmaxf(point->max, value);
+        sum += value;
+        count++;
+    }
+    point->mean = (count > 0) ? (float) (sum / count) : NAN;
+    point->samples = (uint32_t) (end - first);
+}
+
+int DecimationPyramid::query(const size_t field, const int64_t from_ms, const int64_t to_ms,
+                             const size_t max_points, std::vector<pyramid_point_t>& out) const
+{
+    out.clear();
+    if ((samples_ == 0) || (field >= nbr_of_fields_) || (max_points == 0) || (from_ms > to_ms))
+    {
+        return -1;
+    }
+
+    // Finds the buckets of a level that overlap the range: t_last >= from and
+    // t_first <= to, both sorted. The samples of level 0 end where they start.
+    auto find_range = [&](const level_t& l, size_t* lo, size_t* hi)
+    {
+        const std::vector<int64_t>& t_last = (&l == &levels_[0]) ? l.t_first : l.t_last;
+        size_t a = 0;
+        size_t b = l.size;
+        while (a < b)
+        {
+            const size_t mid = (a + b) / 2;
+            if (t_last[index(l, mid)] < from_ms) { a = mid + 1; } else { b = mid; }
+        }
+        *lo = a;
+        b = l.size;
+        while (a < b)
+        {
+            const size_t mid = (a + b) / 2;
+            if (l.t_first[index(l, mid)] <= to_ms) { a = mid + 1; } else { b = mid; }
+        }
+        *hi = a;
+    };
+
+    // Pending buckets in the range, of the stored levels up to level
+    auto pending_in_range = [&](const size_t level)
+    {
+        size_t n = 0;
+        for (size_t k = level; k > PYRAMID_VIRTUAL_LEVELS; k--)
+        {
+            const bucket_t& p = levels_[k].pending;
+            n += ((p.count > 0) && (p.t_last >= from_ms) && (p.t_first <= to_ms)) ? 1 : 0;
+        }
+        return n;
+    };
+
+    const level_t& raw = levels_[0];
+    size_t raw_lo;
+    size_t raw_hi;
+    find_range(raw, &raw_lo, &raw_hi);
+    const bool raw_covers = !raw.evicted || (raw.t_first[index(raw, 0)] <= from_ms);
+    // Sample number of level 0 bucket 0, virtual buckets are aligned to it
+    const uint64_t raw_base = samples_ - raw.size;
+
+    // Find the finest level that covers the range in max_points
+    size_t level = 0;
+    size_t lo = 0;
+    size_t hi = 0;
+
+    for (level = 0; level < levels_.size(); level++)
+    {
+        size_t points;
+        bool covers;
+
+        if (level <= PYRAMID_VIRTUAL_LEVELS)
+        {
+            points = (raw_hi > raw_lo) ? (((raw_base + raw_hi - 1) >> level) - ((raw_base + raw_lo) >> level) + 1) : 0;
+            covers = raw_covers;
+        }
+        else
+        {
+            const level_t& l = levels_[level];
+            find_range(l, &lo, &hi);
+            points = (hi - lo) + pending_in_range(level);
+            covers = !l.evicted || (l.t_first[index(l, 0)] <= from_ms);
+        }
+
+        if ((covers && (points <= max_points)) || (level == levels_.size() - 1))
+        {
+            break;
+        }
+    }
+
+    pyramid_point_t point;
+
+    if (level <= PYRAMID_VIRTUAL_LEVELS)
+    {
+        // Groups of 2^level samples, aligned like the stored buckets
+        size_t i = raw_lo;
+        while (i < raw_hi)
+        {
+            const uint64_t group = ((raw_base + i) >> level) << level;
+            const size_t first = (group > raw_base) ? (size_t) (group - raw_base) : 0;
+            const size_t end = std::min((size_t) (group + (1u << level) - raw_base), raw.size);
+            merge_samples(first, end, field, &point);
+            out.push_back(point);
+            i = end;
+        }
+    }
+    else
+    {
+        for (size_t i = lo; i < hi; i++)
+        {
+            get_point(level, i, field, &point);
+            out.push_back(point);
+        }
+        for (size_t k = level; k > PYRAMID_VIRTUAL_LEVELS; k--)
+        {
+            const bucket_t& p = levels_[k].pending;
+            if ((p.count > 0) && (p.t_last >= from_ms) && (p.t_first <= to_ms))
+            {
+                out.push_back({ p.t_first, p.min[field], p.max[field], p.mean[field], p.count });
+            }
+        }
+    }
+
+    // Only when even the top level has more points than asked for: merge
+    // neighbouring points
+    if (out.size() > max_points)
+    {
+        const size_t group = (out.size() + max_points - 1) / max_points;
+        size_t n = 0;
+        for (size_t i = 0; i < out.size(); i += group)
+        {
+            pyramid_point_t merged = out[i];
+            merged.samples = 0;
+            double sum = 0;
+            uint64_t total = 0;
+            for (size_t j = i; (j < i + group) && (j < out.size()); j++)
+            {
+                merged.min = fminf(merged.min, out[j].min);
+                merged.max = fmaxf(merged.max, out[j].max);
+                merged.samples += out[j].samples;
+                if (!isnan(out[j].mean))
+                {
+                    sum += (double) out[j].mean * out[j].samples;
+                    total += out[j].samples;
+                }
+            }
+            merged.mean = (total > 0) ? (float) (sum / total) : NAN;
+            out[n++] = merged;
+        }
+        out.resize(n);
+    }
+
+    return (int) level;
+}
+
+size_t DecimationPyramid::memory_bytes() const
+{
+    size_t bytes = sizeof(*this);
+    for (const level_t& l : levels_)
+    {
+        bytes += sizeof(l);
+        bytes += (l.t_first.capacity() + l.t_last.capacity()) * sizeof(int64_t);
+        bytes += (l.min.capacity() + l.max.capacity() + l.mean.capacity()) * sizeof(float);
+        bytes += (l.pending.min.capacity() + l.pending.max.capacity() + l.pending.mean.capacity()) * sizeof(float);
+    }
+    return bytes;
+}
+
+void DecimationPyramid::shrink_to_fit()
+{
+    for (level_t& l : levels_)
+    {
+        l.t_first.shrink_to_fit();
+        l.t_last.shrink_to_fit();
+        l.min.shrink_to_fit();
+        l.max.shrink_to_fit();
+        l.mean.shrink_to_fit();
+    }
+}
+
+
+// -- PyramidSink -- //
+
+/* Appends a float with the 9 digits it takes to read back the same float */
+static void append_float(std::string& out, const float value)
+{
+    char buf[32];
+    const int len = isfinite(value) ? snprintf(buf, sizeof(buf), "%.9g", value) : snprintf(buf, sizeof(buf), "null");
+    out.append(buf, len);
+}
+
+PyramidSink::PyramidSink(const size_t capacity)
+    : capacity_(capacity)
+{
+}
+
+/* Adds a decoded record to its series, for log_block_dispatch() */
+struct PyramidSink::Adder
+{
+    PyramidSink&        sink;
+    const log_record_t& record;
+
+    template <typename Block>
+    void operator()(const Block& data, const uint64_t field_mask)
+    {
+        typedef log_block_traits<Block> traits;
+
+        // Filtered blocks go to the series of their full block
+        const uint32_t key = ((uint32_t) record.node << 8) | traits::log_type;
+        auto it = sink.series_.find(key);
+        if (it == sink.series_.end())
+        {
+            series_t series;
+            series.node = record.node;
+            series.type = traits::log_type;
+            series.fields = traits::fields;
+            series.pyramid.reset(new DecimationPyramid(traits::nbr_of_fields, sink.capacity_));
+            it = sink.series_.emplace(key, std::move(series)).first;
+        }
+
+        float values[traits::nbr_of_fields];
+        traits::visit(data, [&](const uint8_t index, const char*, const auto value)
+        {
+            values[index] = (field_mask & (1ULL << index)) ? (float) value : NAN;
+        });
+        it->second.pyramid->add(record.time_ms, values);
+    }
+};
+
+void PyramidSink::on_record(const log_record_t& record)
+{
+    log_block_dispatch(record.header.type, record.data, record.size, Adder { *this, record });
+}
+
+bool PyramidSink::query_json(const std::string& query, std::string& out) const
+{
+    std::string field_name;
+    std::string value;
+
+    if (!StreamServer::query_param(query, "field", field_name))
+    {
+        out = "Missing field=<name>\n";
+        return false;
+    }
+
+    const uint16_t node = StreamServer::query_param(query, "node", value) ? (uint16_t) atoi(value.c_str()) : 0;
+    std::string block;
+    StreamServer::query_param(query, "block", block);
+
+    const int64_t from_ms = StreamServer::query_param(query, "from", value) ? strtoll(value.c_str(), NULL, 10) : INT64_MIN;
+    const int64_t to_ms = StreamServer::query_param(query, "to", value) ? strtoll(value.c_str(), NULL, 10) : INT64_MAX;
+    size_t max_points = StreamServer::query_param(query, "n", value) ? strtoul(value.c_str(), NULL, 10) : PYRAMID_DEFAULT_POINTS;
+    if ((max_points == 0) || (max_points > PYRAMID_MAX_POINTS))
+    {
+        max_points = PYRAMID_MAX_POINTS;
+    }
+
+    // Find the series and the field
+    const series_t* series = NULL;
+    size_t field = 0;
+    for (const auto& it : series_)
+    {
+        const series_t& s = it.second;
+        if ((s.node != node) || (!block.empty() && (block != log_block_name(s.type))))
+        {
+            continue;
+        }
+        for (size_t i = 0; i < s.pyramid->nbr_of_fields(); i++)
+        {
+            if (field_name == s.fields[i].name)
+            {
+                series = &s;
+                field = i;
+                break;
+            }
+        }
+        if (series != NULL)
+        {
+            break;
+        }
+    }
+
+    if (series == NULL)
+    {
+        out = "No data for field " + field_name + "\n";
+        return false;
+    }
+
+    std::vector<pyramid_point_t> points;
+    const int level = series->pyramid->query(field, from_ms, to_ms, max_points, points);
+
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "{\"node\":%u,\"block\":\"%s\",\"field\":\"%s\",\"level\":%d,\"points\":[",
+             (unsigned) series->node, log_block_name(series->type), series->fields[field].name, level);
+    out = buf;
+
+    // [time, min, max, mean, samples]
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        int len = snprintf(buf, sizeof(buf), "%s[%" PRId64 ",", (i > 0) ? "," : "", points[i].time_ms);
+        out.append(buf, len);
+        append_float(out, points[i].min);
+        out.push_back(',');
+        append_float(out, points[i].max);
+        out.push_back(',');
+        append_float(out, points[i].mean);
+        len = snprintf(buf, sizeof(buf), ",%" PRIu32 "]", points[i].samples);
+        out.append(buf, len);
+    }
+    out.append("]}");
+    return true;
+}
+
+std::string PyramidSink::stats_json() const
+{
+    std::string json = "[";
+    char buf[256];
+
+    for (const auto& it : series_)
+    {
+        const series_t& s = it.second;
+        snprintf(buf, sizeof(buf),
+            "%s{\"node\":%u,\"block\":\"%s\",\"fields\":%zu,\"samples\":%" PRIu64 ","
+            "\"first\":%" PRId64 ",\"last\":%" PRId64 ",\"memory_bytes\":%zu}",
+            (json.size() > 1) ? "," : "", (unsigned) s.node, log_block_name(s.type),
+            s.pyramid->nbr_of_fields(), s.pyramid->samples(),
+            s.pyramid->first_time_ms(), s.pyramid->last_time_ms(), s.pyramid->memory_bytes());
+        json.append(buf);
+    }
+
+    json.append("]");
+    return json;
+}
+
+void PyramidSink::shrink_to_fit()
+{
+    for (auto& it : series_)
+    {
+        it.second.pyramid->shrink_to_fit();
+    }
+}
@@ -0,0 +1,139 @@
+#include "event_loop.h"
+
+#include "stdio.h"
+#include "errno.h"
+#include "time.h"
+#include "unistd.h"
+#include "sys/epoll.h"
+#include "sys/timerfd.h"
+
+
+#define EVENT_LOOP_MAX_EVENTS 64
+
+
+EventLoop::EventLoop()
+    : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      running_(false)
+{
+    if (epoll_fd_ == -1)
+    {
+        printf("Failed to create epoll instance: %d\n", errno);
+    }
+}
+
+EventLoop::~EventLoop()
+{
+    close(epoll_fd_);
+}
+
+bool EventLoop::add(const int fd, const uint32_t events, fd_handler_t handler)
+{
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.fd = fd;
+
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) == -1)
+    {
+        printf("Failed to add fd %d to event loop: %d\n", fd, errno);
+        return false;
+    }
+
+    handlers_[fd] = handler;
+    return true;
+}
+
+void EventLoop::modify(const int fd, const uint32_t events)
+{
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.fd = fd;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev);
+}
+
+void EventLoop::remove(const int fd)
+{
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, NULL);
+    handlers_.erase(fd);
+}
+
+int EventLoop::add_timer(const uint32_t period_ms, timer_handler_t handler)
+{
+    const int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd == -1)
+    {
+        return -1;
+    }
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = period_ms / 1000;
+    spec.it_interval.tv_nsec = (period_ms % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+    timerfd_settime(timer_fd, 0, &spec, NULL);
+
+    bool added = add(timer_fd, EPOLLIN, [timer_fd, handler](uint32_t)
+    {
+        uint64_t expirations;
+        if (read(timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+        {
+            handler();
+        }
+    });
+
+    if (!added)
+    {
+        close(timer_fd);
+        return -1;
+    }
+    return timer_fd;
+}
+
+void EventLoop::remove_timer(const int timer_fd)
+{
+    remove(timer_fd);
+    close(timer_fd);
+}
+
+void EventLoop::run()
+{
+    struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+    running_ = true;
+
+    while (running_)
+    {
+        int n = epoll_wait(epoll_fd_, events, EVENT_LOOP_MAX_EVENTS, -1);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            printf("epoll_wait failed: %d\n", errno);
+            break;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            auto it = handlers_.find(events[i].data.fd);
+            if (it == handlers_.end())
+            {   // Removed by an earlier handler in this batch
+                continue;
+            }
+
+            // Copy, since the handler may remove itself
+            fd_handler_t handler = it->second;
+            handler(events[i].events);
+        }
+    }
+}
+
+void EventLoop::stop()
+{
+    running_ = false;
+}
+
+uint64_t EventLoop::now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
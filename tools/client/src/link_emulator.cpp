@@ -0,0 +1,548 @@
+#include "link_emulator.h"
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "unistd.h"
+#include "fcntl.h"
+#include "inttypes.h"
+#include "arpa/inet.h"
+#include "netinet/in.h"
+#include "netinet/tcp.h"
+#include "sys/socket.h"
+#include "sys/epoll.h"
+
+#include <algorithm>
+
+
+// -- LinkTimeline -- //
+
+LinkTimeline::LinkTimeline()
+{
+    // A perfect link until the timeline says otherwise
+    link_segment_t link;
+    link.t_us = 0;
+    link.up = true;
+    link.disconnect = false;
+    link.bandwidth_kbps = 0;
+    link.latency_ms = 0;
+    link.jitter_ms = 0;
+    link.loss_pct = 0;
+    link.loss_burst = 1;
+    segments_.push_back(link);
+}
+
+bool LinkTimeline::load(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == NULL)
+    {
+        printf("Failed to open timeline %s\n", path.c_str());
+        return false;
+    }
+
+    char line[256];
+    int line_nbr = 0;
+    bool ok = true;
+
+    while (ok && (fgets(line, sizeof(line), file) != NULL))
+    {
+        line_nbr++;
+        char* comment = strchr(line, '#');
+        if (comment != NULL)
+        {
+            *comment = '\0';
+        }
+
+        char* token = strtok(line, " \t\r\n");
+        if (token == NULL)
+        {
+            continue;
+        }
+
+        char* end;
+        const double t_s = strtod(token, &end);
+        link_segment_t link = segments_.back();
+        link.t_us = (uint64_t) (t_s * 1e6);
+        link.disconnect = false;
+        if ((*end != '\0') || (t_s < 0) || (link.t_us < segments_.back().t_us))
+        {
+            printf("%s:%d: expected a time in seconds, not before the line above\n", path.c_str(), line_nbr);
+            ok = false;
+            break;
+        }
+
+        while (ok && ((token = strtok(NULL, " \t\r\n")) != NULL))
+        {
+            char* value = strchr(token, '=');
+            if (value != NULL)
+            {
+                *value++ = '\0';
+            }
+
+            if (strcmp(token, "down") == 0)             { link.up = false; }
+            else if (strcmp(token, "up") == 0)          { link.up = true; }
+            else if (strcmp(token, "disconnect") == 0)  { link.disconnect = true; }
+            else if (value == NULL)                     { ok = false; }
+            else if (strcmp(token, "bw") == 0)          { link.bandwidth_kbps = atoi(value); }
+            else if (strcmp(token, "latency") == 0)     { link.latency_ms = atoi(value); }
+            else if (strcmp(token, "jitter") == 0)      { link.jitter_ms = atoi(value); }
+            else if (strcmp(token, "loss") == 0)        { link.loss_pct = atof(value); }
+            else if (strcmp(token, "burst") == 0)       { link.loss_burst = std::max(1.0, atof(value)); }
+            else                                        { ok = false; }
+
+            if (!ok)
+            {
+                printf("%s:%d: unknown setting '%s'\n", path.c_str(), line_nbr, token);
+            }
+        }
+
+        // A segment at the same time replaces the one before, e.g. at 0
+        if (link.t_us == segments_.back().t_us)
+        {
+            segments_.back() = link;
+        }
+        else
+        {
+            segments_.push_back(link);
+        }
+    }
+
+    fclose(file);
+    return ok;
+}
+
+size_t LinkTimeline::index_at(const uint64_t t_us) const
+{
+    auto it = std::upper_bound(segments_.begin(), segments_.end(), t_us,
+                               [](const uint64_t t, const link_segment_t& link) { return t < link.t_us; });
+    return (it - segments_.begin()) - 1;
+}
+
+uint64_t LinkTimeline::next_up(const uint64_t t_us) const
+{
+    for (size_t i = index_at(t_us); i < segments_.size(); i++)
+    {
+        if (segments_[i].up)
+        {
+            return std::max(t_us, segments_[i].t_us);
+        }
+    }
+    return UINT64_MAX;
+}
+
+
+// -- LinkEmulator -- //
+
+LinkEmulator::LinkEmulator(EventLoop& loop, const int listen_port, const std::string& node_ip, const int node_port)
+    : loop_(loop),
+      listen_port_(listen_port),
+      node_ip_(node_ip),
+      node_port_(node_port),
+      window_(LINK_EMULATOR_WINDOW),
+      rng_(1),
+      arrivals_file_(NULL),
+      listen_fd_(-1),
+      client_fd_(-1),
+      node_fd_(-1),
+      tick_timer_(-1),
+      t0_us_(0),
+      segment_(0),
+      from_node_(),
+      from_client_(),
+      connections_(0),
+      disconnects_(0)
+{
+    from_node_.from = "node";
+    from_client_.from = "client";
+}
+
+LinkEmulator::~LinkEmulator()
+{
+    close_connections();
+    if (listen_fd_ != -1)
+    {
+        loop_.remove(listen_fd_);
+        close(listen_fd_);
+    }
+    if (tick_timer_ != -1)
+    {
+        loop_.remove_timer(tick_timer_);
+    }
+    if (arrivals_file_ != NULL)
+    {
+        fclose(arrivals_file_);
+    }
+}
+
+bool LinkEmulator::log_arrivals(const std::string& path)
+{
+    arrivals_file_ = fopen(path.c_str(), "w");
+    if (arrivals_file_ == NULL)
+    {
+        printf("Failed to open %s\n", path.c_str());
+        return false;
+    }
+    fprintf(arrivals_file_, "read_us,arrival_us,from,bytes,lost,retransmits,queued_bytes,segment,timeout\n");
+    return true;
+}
+
+bool LinkEmulator::start()
+{
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ == -1)
+    {
+        printf("Failed to open socket\n");
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(listen_port_);
+
+    if (bind(listen_fd_, (struct sockaddr*) &addr, sizeof(addr)) == -1)
+    {
+        printf("Failed to bind port %d, error: %d\n", listen_port_, errno);
+        return false;
+    }
+
+    if (listen(listen_fd_, 1) == -1)
+    {
+        printf("Failed to listen on port %d, error: %d\n", listen_port_, errno);
+        return false;
+    }
+    loop_.add(listen_fd_, EPOLLIN, [this](uint32_t) { on_accept(); });
+
+    t0_us_ = EventLoop::now_us();
+    log_segment(t0_us_, 0);
+    tick_timer_ = loop_.add_timer(LINK_EMULATOR_TICK_MS, [this]() { on_tick(); });
+
+    printf("Link emulator: 127.0.0.1:%d -> %s:%d, %zu timeline segments, window %zu B\n",
+           listen_port_, node_ip_.c_str(), node_port_, timeline_.size(), window_);
+    return true;
+}
+
+void LinkEmulator::print_stats() const
+{
+    printf("Connections: %" PRIu64 ", disconnects: %" PRIu64 "\n", connections_, disconnects_);
+    for (const direction_t* dir : { &from_node_, &from_client_ })
+    {
+        printf("From %-6s: %" PRIu64 " packets, %" PRIu64 " bytes, %" PRIu64 " lost, %" PRIu64 " retransmits, "
+               "%" PRIu64 " timeouts\n",
+               dir->from, dir->packets, dir->bytes, dir->lost, dir->retransmits, dir->timeouts);
+    }
+}
+
+void LinkEmulator::on_accept()
+{
+    const int fd = accept4(listen_fd_, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd == -1)
+    {
+        return;
+    }
+
+    // The node only serves one client, and nobody gets through a link that is down
+    const link_segment_t& link = timeline_.segment(segment_);
+    if ((client_fd_ != -1) || !link.up)
+    {
+        close(fd);
+        return;
+    }
+
+    // Blocking connect, the node is on localhost
+    node_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr(node_ip_.c_str());
+    addr.sin_port = htons(node_port_);
+
+    if ((node_fd_ == -1) || (connect(node_fd_, (struct sockaddr*) &addr, sizeof(addr)) == -1))
+    {
+        printf("Failed to connect to node %s:%d, error: %d\n", node_ip_.c_str(), node_port_, errno);
+        if (node_fd_ != -1)
+        {
+            close(node_fd_);
+            node_fd_ = -1;
+        }
+        close(fd);
+        return;
+    }
+    client_fd_ = fd;
+    connections_++;
+
+    int nodelay = 1;
+    setsockopt(client_fd_, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    setsockopt(node_fd_, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    fcntl(node_fd_, F_SETFL, fcntl(node_fd_, F_GETFL) | O_NONBLOCK);
+
+    loop_.add(client_fd_, EPOLLIN, [this](uint32_t events) { on_tcp_event(false, events); });
+    loop_.add(node_fd_, EPOLLIN, [this](uint32_t events) { on_tcp_event(true, events); });
+    from_client_.reading = true;
+    from_node_.reading = true;
+
+    printf("t=%.1f s: client connected\n", (EventLoop::now_us() - t0_us_) / 1e6);
+}
+
+void LinkEmulator::on_tcp_event(const bool from_node, const uint32_t)
+{
+    direction_t& dir = from_node ? from_node_ : from_client_;
+    const int fd = from_node ? node_fd_ : client_fd_;
+    uint8_t buf[LINK_EMULATOR_MSS];
+
+    // Only take what fits in the window, the rest stays with the sender
+    while (dir.queued_bytes < window_)
+    {
+        const ssize_t res = recv(fd, buf, sizeof(buf), 0);
+        if (res > 0)
+        {
+            send(dir, buf, res);
+            continue;
+        }
+        if ((res == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK)))
+        {
+            printf("t=%.1f s: %s closed the connection\n", (EventLoop::now_us() - t0_us_) / 1e6, dir.from);
+            close_connections();
+            return;
+        }
+        break;
+    }
+    update_reading(dir, fd);
+}
+
+void LinkEmulator::on_tick()
+{
+    const uint64_t now = EventLoop::now_us();
+    const size_t segment = timeline_.index_at(now - t0_us_);
+
+    if (segment != segment_)
+    {
+        segment_ = segment;
+        const link_segment_t& link = timeline_.segment(segment);
+        printf("t=%.1f s: %s, %u kbit/s, latency %u+%u ms, loss %.1f%% (bursts of %.1f)%s\n",
+               (now - t0_us_) / 1e6, link.up ? "up" : "down", link.bandwidth_kbps,
+               link.latency_ms, link.jitter_ms, link.loss_pct, link.loss_burst,
+               link.disconnect ? ", disconnecting" : "");
+        log_segment(now, segment);
+        if (link.disconnect)
+        {
+            disconnects_++;
+            close_connections();
+        }
+    }
+
+    if (client_fd_ != -1)
+    {
+        if (!deliver(from_node_, client_fd_, now) || !deliver(from_client_, node_fd_, now))
+        {
+            close_connections();
+            return;
+        }
+        update_reading(from_node_, node_fd_);
+        update_reading(from_client_, client_fd_);
+    }
+}
+
+void LinkEmulator::close_connections()
+{
+    for (int* fd : { &client_fd_, &node_fd_ })
+    {
+        if (*fd != -1)
+        {
+            loop_.remove(*fd);
+            close(*fd);
+            *fd = -1;
+        }
+    }
+
+    // Whatever was in flight is lost with the connection
+    for (direction_t* dir : { &from_node_, &from_client_ })
+    {
+        for (const packet_t& packet : dir->queue)
+        {
+            log_packet(*dir, packet, true);
+        }
+        dir->lost += dir->queue.size();
+        dir->queue.clear();
+        dir->queued_bytes = 0;
+        dir->busy_until_us = 0;
+        dir->last_arrival_us = 0;
+        dir->reading = false;
+    }
+}
+
+void LinkEmulator::update_reading(direction_t& dir, const int fd)
+{
+    const bool reading = dir.queued_bytes < window_;
+    if (reading != dir.reading)
+    {
+        loop_.modify(fd, reading ? (uint32_t) EPOLLIN : 0u);
+        dir.reading = reading;
+    }
+}
+
+void LinkEmulator::send(direction_t& dir, const uint8_t* data, const size_t size)
+{
+    const uint64_t now = EventLoop::now_us();
+
+    packet_t packet;
+    packet.read_us = now;
+    packet.arrival_us = UINT64_MAX;
+    packet.retransmits = 0;
+    packet.timed_out = false;
+    packet.queued_bytes = dir.queued_bytes;
+    packet.segment = timeline_.index_at(now - t0_us_);
+    packet.data.assign(data, data + size);
+    packet.sent = 0;
+
+    dir.packets++;
+    dir.bytes += size;
+
+    // Wait for the packets before it, then for the link to be up
+    uint64_t start = std::max(now, dir.busy_until_us);
+    if ((start != UINT64_MAX) && !timeline_.segment(timeline_.index_at(start - t0_us_)).up)
+    {
+        const uint64_t up = timeline_.next_up(start - t0_us_);
+        start = (up == UINT64_MAX) ? UINT64_MAX : (t0_us_ + up);
+    }
+
+    if (start != UINT64_MAX)
+    {
+        const link_segment_t& link = timeline_.segment(timeline_.index_at(start - t0_us_));
+        // bytes * 8 / (kbit/s * 1000) s
+        const uint64_t depart = start + ((link.bandwidth_kbps > 0) ? (size * 8000ULL / link.bandwidth_kbps) : 0);
+        uint64_t stall = 0;
+
+        // Retransmitted until it gets through, with exponential backoff.
+        // A retry goes out an RTO later, after the burst, so it is lost
+        // at the average rate.
+        const uint64_t rto = std::max<uint64_t>(LINK_EMULATOR_MIN_RTO_MS, 2 * (link.latency_ms + link.jitter_ms)) * 1000;
+        std::uniform_real_distribution<double> uniform(0.0, 100.0);
+        bool lost = is_lost(dir, link);
+        while (lost && (packet.retransmits < LINK_EMULATOR_MAX_RETRIES))
+        {
+            stall += rto << packet.retransmits;
+            packet.retransmits++;
+            lost = (uniform(rng_) < link.loss_pct);
+        }
+        if (lost)
+        {   // The last retry is lost too, the sender gives up one more RTO later
+            stall += rto << packet.retransmits;
+            packet.timed_out = true;
+        }
+        dir.retransmits += packet.retransmits;
+
+        const uint64_t jitter = (link.jitter_ms > 0) ? (rng_() % (link.jitter_ms * 1000ULL + 1)) : 0;
+        packet.arrival_us = depart + stall + link.latency_ms * 1000ULL + jitter;
+        // Stays in order, like TCP and like a single WiFi queue. The packets
+        // behind a retransmitted one keep being sent within the window, but
+        // are only handed over after it.
+        packet.arrival_us = std::max(packet.arrival_us, dir.last_arrival_us);
+        dir.last_arrival_us = packet.arrival_us;
+        dir.busy_until_us = depart;
+    }
+    else
+    {   // Never up again, keeps the window full
+        dir.busy_until_us = UINT64_MAX;
+    }
+
+    dir.queued_bytes += size;
+    dir.queue.push_back(std::move(packet));
+}
+
+bool LinkEmulator::is_lost(direction_t& dir, const link_segment_t& link)
+{
+    if (link.loss_pct <= 0)
+    {
+        dir.in_burst = false;
+        return false;
+    }
+
+    // Two states: a burst lasts 1 / (1 - stay) = loss_burst packets on
+    // average, and starts often enough for loss_pct overall
+    const double loss = std::min(link.loss_pct / 100.0, 1.0);
+    const double stay = 1.0 - 1.0 / link.loss_burst;
+    const double start = loss / (link.loss_burst * (1.0 - loss) + loss);
+    const double r = std::uniform_real_distribution<double>(0.0, 1.0)(rng_);
+
+    dir.in_burst = (r < (dir.in_burst ? stay : start));
+    return dir.in_burst;
+}
+
+bool LinkEmulator::deliver(direction_t& dir, const int fd, const uint64_t now)
+{
+    // Packets on their way when the link went down wait for it to be up
+    if (!timeline_.segment(segment_).up)
+    {
+        return true;
+    }
+
+    while (!dir.queue.empty() && (dir.queue.front().arrival_us <= now))
+    {
+        packet_t& packet = dir.queue.front();
+
+        if (packet.timed_out)
+        {   // Out of retries, TCP drops the connection
+            printf("t=%.1f s: TCP segment from %s timed out after %u retransmits\n",
+                   (now - t0_us_) / 1e6, dir.from, (unsigned) packet.retransmits);
+            log_packet(dir, packet, true, true);
+            dir.lost++;
+            dir.timeouts++;
+            dir.queued_bytes -= packet.data.size();
+            dir.queue.pop_front();
+            return false;
+        }
+
+        const ssize_t res = ::send(fd, packet.data.data() + packet.sent, packet.data.size() - packet.sent,
+                                   MSG_NOSIGNAL);
+        if (res < 0)
+        {
+            // Receiver is slow, try again next tick
+            return (errno == EAGAIN) || (errno == EWOULDBLOCK);
+        }
+
+        packet.sent += res;
+        if (packet.sent < packet.data.size())
+        {
+            return true;
+        }
+
+        // Arrived once the receiver took it, which may be later than scheduled
+        packet.arrival_us = now;
+        log_packet(dir, packet, false);
+        dir.queued_bytes -= packet.data.size();
+        dir.queue.pop_front();
+    }
+    return true;
+}
+
+void LinkEmulator::log_packet(const direction_t& dir, const packet_t& packet, const bool lost, const bool timeout)
+{
+    if (arrivals_file_ == NULL)
+    {
+        return;
+    }
+
+    char arrival[24] = "";
+    if (!lost)
+    {
+        snprintf(arrival, sizeof(arrival), "%" PRIu64, packet.arrival_us);
+    }
+    fprintf(arrivals_file_, "%" PRIu64 ",%s,%s,%zu,%d,%u,%zu,%zu,%d\n",
+            packet.read_us, arrival, dir.from, packet.data.size(), lost ? 1 : 0,
+            (unsigned) packet.retransmits, packet.queued_bytes, packet.segment, timeout ? 1 : 0);
+}
+
+void LinkEmulator::log_segment(const uint64_t now, const size_t segment)
+{
+    if (arrivals_file_ != NULL)
+    {
+        fprintf(arrivals_file_, "%" PRIu64 ",%" PRIu64 ",link,0,0,0,0,%zu,0\n", now, now, segment);
+    }
+}
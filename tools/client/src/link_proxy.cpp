@@ -0,0 +1,110 @@
+/*
+ * WiFi link emulator for benchmarking the node's buffering in repeatable
+ * runs on localhost.
+ *
+ * Sits between a telemetry node (e.g. tools/host_node) and its client, and
+ * imposes the bandwidth, latency, jitter, loss bursts, outages and
+ * disconnects of a timeline file on the traffic, see link_emulator.h.
+ * Every packet is logged with its arrival time, for tools/link_report.py.
+ *
+ * Usage: link_proxy [-t <timeline>] [-o <arrivals csv>] [-w <window bytes>] [-s <seed>]
+ *                   [-d <duration s>] <listen port> <node ip>[:port]
+ * The node port defaults to 80. Without -d the proxy runs until
+ * interrupted. Only TCP is relayed, nodes don't serve anything else.
+ */
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "unistd.h"
+#include "signal.h"
+
+#include <string>
+
+#include "event_loop.h"
+#include "link_emulator.h"
+
+
+static EventLoop* loop_to_stop = NULL;
+
+static void on_signal(int)
+{
+    if (loop_to_stop != NULL)
+    {
+        loop_to_stop->stop();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char* timeline_path = NULL;
+    const char* arrivals_path = NULL;
+    size_t window = LINK_EMULATOR_WINDOW;
+    uint32_t seed = 1;
+    double duration_s = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:o:w:s:d:")) != -1)
+    {
+        switch (opt)
+        {
+            case 't': timeline_path = optarg; break;
+            case 'o': arrivals_path = optarg; break;
+            case 'w': window = atoi(optarg); break;
+            case 's': seed = atoi(optarg); break;
+            case 'd': duration_s = atof(optarg); break;
+            default:
+                printf("Usage: %s [-t timeline] [-o arrivals_csv] [-w window_bytes] [-s seed] [-d duration_s] "
+                       "<listen port> <node ip>[:port]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (argc - optind != 2)
+    {
+        printf("Must supply the listen port and the IP of the telemetry node\n");
+        return 1;
+    }
+
+    const int listen_port = atoi(argv[optind]);
+    const char* node = argv[optind + 1];
+    const char* colon = strchr(node, ':');
+    const std::string node_ip = (colon == NULL) ? std::string(node) : std::string(node, colon - node);
+    const int node_port = (colon == NULL) ? 80 : atoi(colon + 1);
+
+    LinkTimeline timeline;
+    if ((timeline_path != NULL) && !timeline.load(timeline_path))
+    {
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    EventLoop loop;
+    loop_to_stop = &loop;
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    LinkEmulator emulator(loop, listen_port, node_ip, node_port);
+    emulator.set_timeline(timeline);
+    emulator.set_window(window);
+    emulator.set_seed(seed);
+
+    if ((arrivals_path != NULL) && !emulator.log_arrivals(arrivals_path))
+    {
+        return 1;
+    }
+    if (!emulator.start())
+    {
+        return 1;
+    }
+
+    if (duration_s > 0)
+    {
+        loop.add_timer((uint32_t) (duration_s * 1000), [&loop]() { loop.stop(); });
+    }
+
+    loop.run();
+
+    emulator.print_stats();
+    return 0;
+}
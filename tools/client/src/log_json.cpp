@@ -0,0 +1,80 @@
+#include "log_json.h"
+
+#include "stdio.h"
+#include "string.h"
+#include "math.h"
+#include "inttypes.h"
+
+
+// One overload per schema type, picked at compile time for every field.
+// Inline, since a schema need not use every type.
+static inline int format_value(char* buf, const size_t size, const bool v)     { return snprintf(buf, size, "%s", v ? "true" : "false"); }
+static inline int format_value(char* buf, const size_t size, const uint8_t v)  { return snprintf(buf, size, "%u", (unsigned) v); }
+static inline int format_value(char* buf, const size_t size, const int8_t v)   { return snprintf(buf, size, "%d", (int) v); }
+static inline int format_value(char* buf, const size_t size, const uint16_t v) { return snprintf(buf, size, "%u", (unsigned) v); }
+static inline int format_value(char* buf, const size_t size, const int16_t v)  { return snprintf(buf, size, "%d", (int) v); }
+static inline int format_value(char* buf, const size_t size, const uint32_t v) { return snprintf(buf, size, "%" PRIu32, v); }
+static inline int format_value(char* buf, const size_t size, const int32_t v)  { return snprintf(buf, size, "%" PRId32, v); }
+static inline int format_value(char* buf, const size_t size, const uint64_t v) { return snprintf(buf, size, "%" PRIu64, v); }
+static inline int format_value(char* buf, const size_t size, const int64_t v)  { return snprintf(buf, size, "%" PRId64, v); }
+
+static inline int format_value(char* buf, const size_t size, const float v)
+{
+    return isfinite(v) ? snprintf(buf, size, "%.7g", v) : snprintf(buf, size, "null");
+}
+
+static inline int format_value(char* buf, const size_t size, const double v)
+{
+    return isfinite(v) ? snprintf(buf, size, "%.15g", v) : snprintf(buf, size, "null");
+}
+
+/* Appends the header and the fields of field_mask, for log_block_dispatch() */
+struct JsonWriter
+{
+    const log_record_t& record;
+    std::string&        out;
+
+    template <typename Block>
+    void operator()(const Block& data, const uint64_t field_mask)
+    {
+        typedef log_block_traits<Block> traits;
+        char buf[128];
+
+        // Filtered blocks are named after their full block
+        int len = snprintf(buf, sizeof(buf), "{\"node\":%u,\"time\":%" PRId64 ",\"type\":\"%s\",\"timestamp\":%" PRIu32 ",\"id\":%" PRIu32 ",\"data\":{",
+                           (unsigned) record.node, record.time_ms, traits::block_name, record.header.timestamp, record.header.id);
+        out.append(buf, len);
+
+        bool first = true;
+        traits::visit(data, [&](const uint8_t index, const char* name, const auto value)
+        {
+            if (!(field_mask & (1ULL << index)))
+            {
+                return;
+            }
+            if (!first)
+            {
+                out.push_back(',');
+            }
+            first = false;
+            out.push_back('"');
+            out.append(name);
+            out.append("\":");
+            const int value_len = format_value(buf, sizeof(buf), value);
+            out.append(buf, value_len);
+        });
+
+        out.append("}}");
+    }
+};
+
+void log_record_to_json(const log_record_t& record, std::string& out)
+{
+    if (!log_block_dispatch(record.header.type, record.data, record.size, JsonWriter { record, out }))
+    {
+        char buf[128];
+        const int len = snprintf(buf, sizeof(buf), "{\"node\":%u,\"time\":%" PRId64 ",\"type\":\"unknown\",\"timestamp\":%" PRIu32 ",\"id\":%" PRIu32 ",\"data\":{}}",
+                                 (unsigned) record.node, record.time_ms, record.header.timestamp, record.header.id);
+        out.append(buf, len);
+    }
+}
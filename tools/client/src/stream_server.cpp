@@ -0,0 +1,485 @@
+#include "stream_server.h"
+#include "log_json.h"
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "unistd.h"
+#include "arpa/inet.h"
+#include "netinet/in.h"
+#include "netinet/tcp.h"
+#include "sys/socket.h"
+#include "sys/epoll.h"
+
+
+StreamServer::StreamServer(EventLoop& loop, const int port)
+    : loop_(loop),
+      port_(port),
+      server_fd_(-1),
+      tick_timer_(-1),
+      last_tick_us_(0),
+      frames_(STREAM_SERVER_MAX_FRAMES),
+      next_seq_(0),
+      clients_total_(0)
+{
+}
+
+StreamServer::~StreamServer()
+{
+    for (auto& it : clients_)
+    {
+        if (it.second.fd != -1)
+        {
+            loop_.remove(it.second.fd);
+            close(it.second.fd);
+        }
+    }
+    clients_.clear();
+    if (tick_timer_ != -1)
+    {
+        loop_.remove_timer(tick_timer_);
+    }
+    if (server_fd_ != -1)
+    {
+        loop_.remove(server_fd_);
+        close(server_fd_);
+    }
+}
+
+bool StreamServer::start()
+{
+    server_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server_fd_ == -1)
+    {
+        printf("Failed to open TCP socket\n");
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(server_fd_, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port_);
+
+    if (bind(server_fd_, (struct sockaddr*) &addr, sizeof(addr)) == -1)
+    {
+        printf("Failed to bind server socket on port %d, error: %d\n", port_, errno);
+        return false;
+    }
+    if (listen(server_fd_, 64) == -1)
+    {
+        printf("Failed to listen server socket on port %d, error: %d\n", port_, errno);
+        return false;
+    }
+
+    loop_.add(server_fd_, EPOLLIN, [this](uint32_t) { on_accept(); });
+
+    last_tick_us_ = EventLoop::now_us();
+    tick_timer_ = loop_.add_timer(STREAM_SERVER_TICK_MS, [this]() { flush_clients(); });
+
+    printf("Starting HTTP server on port %d\n", port_);
+    return true;
+}
+
+void StreamServer::on_record(const log_record_t& record)
+{
+    // Encode once, every client streams the same frame
+    frame_t& frame = frames_[next_seq_ % STREAM_SERVER_MAX_FRAMES];
+    frame.seq = next_seq_++;
+    frame.json.clear();
+    log_record_to_json(record, frame.json);
+}
+
+void StreamServer::add_stats(const std::string& name, std::function<std::string()> provider)
+{
+    stats_.push_back(std::make_pair(name, provider));
+}
+
+void StreamServer::add_endpoint(const std::string& path, endpoint_t handler)
+{
+    endpoints_[path] = handler;
+}
+
+bool StreamServer::query_param(const std::string& query, const char* name, std::string& value)
+{
+    const size_t name_len = strlen(name);
+    size_t pos = 0;
+
+    while (pos < query.size())
+    {
+        size_t end = query.find('&', pos);
+        if (end == std::string::npos)
+        {
+            end = query.size();
+        }
+        if ((query.compare(pos, name_len, name) == 0) && (query[pos + name_len] == '='))
+        {
+            value = query.substr(pos + name_len + 1, end - pos - name_len - 1);
+            return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+void StreamServer::on_accept()
+{
+    while (1)
+    {
+        int fd = accept4(server_fd_, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1)
+        {
+            return;
+        }
+
+        if (clients_.size() >= STREAM_SERVER_MAX_CLIENTS)
+        {
+            close(fd);
+            continue;
+        }
+
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        // Also replaces a closed client that had the same fd
+        client_t& client = clients_[fd];
+        client = client_t();
+        client.fd = fd;
+        client.state = CLIENT_READING_REQUEST;
+        client.out_sent = 0;
+        client.next_seq = next_seq_;
+        client.hz = STREAM_SERVER_DEFAULT_HZ;
+        client.tokens = 0;
+        client.frames_sent = 0;
+        client.frames_dropped = 0;
+        clients_total_++;
+
+        loop_.add(fd, EPOLLIN, [this, fd](uint32_t events) { on_client_event(fd, events); });
+    }
+}
+
+void StreamServer::on_client_event(const int fd, const uint32_t events)
+{
+    auto it = clients_.find(fd);
+    if (it == clients_.end())
+    {
+        return;
+    }
+    client_t& client = it->second;
+
+    handle_client_event(client, events);
+
+    // Closed while handling the event, nothing refers to it anymore
+    if (client.fd == -1)
+    {
+        clients_.erase(it);
+    }
+}
+
+void StreamServer::handle_client_event(client_t& client, const uint32_t events)
+{
+    if (events & EPOLLOUT)
+    {
+        send_pending(client);
+        if (client.fd == -1)
+        {
+            return;
+        }
+    }
+
+    if (!(events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+    {
+        return;
+    }
+
+    char buf[1024];
+    ssize_t res = read(client.fd, buf, sizeof(buf));
+    if ((res == 0) || ((res == -1) && (errno != EAGAIN) && (errno != EWOULDBLOCK)))
+    {
+        close_client(client);
+        return;
+    }
+    if ((res <= 0) || (client.state != CLIENT_READING_REQUEST))
+    {   // Anything sent while streaming is ignored
+        return;
+    }
+
+    client.request.append(buf, res);
+    if (client.request.find("\r\n\r\n") != std::string::npos)
+    {
+        handle_request(client);
+    }
+    else if (client.request.size() >= STREAM_SERVER_REQUEST_MAX)
+    {
+        respond(client, "431 Request Header Fields Too Large", "text/plain", "Request too large\n");
+    }
+}
+
+void StreamServer::handle_request(client_t& client)
+{
+    // Request line: GET <path>[?<query>] HTTP/1.1
+    const std::string& req = client.request;
+    const size_t path_start = req.find(' ');
+    const size_t path_end = (path_start == std::string::npos) ? std::string::npos : req.find(' ', path_start + 1);
+
+    if ((path_end == std::string::npos) || (req.compare(0, path_start, "GET") != 0))
+    {
+        respond(client, "405 Method Not Allowed", "text/plain", "Only GET is supported\n");
+        return;
+    }
+
+    std::string target = req.substr(path_start + 1, path_end - path_start - 1);
+    std::string query;
+    const size_t query_start = target.find('?');
+    if (query_start != std::string::npos)
+    {
+        query = target.substr(query_start + 1);
+        target.resize(query_start);
+    }
+
+    if (target == "/api/stream")
+    {
+        std::string hz;
+        if (query_param(query, "hz", hz))
+        {
+            client.hz = atof(hz.c_str());
+        }
+
+        client.state = CLIENT_STREAMING;
+        client.next_seq = next_seq_;
+        client.request.clear();
+        client.request.shrink_to_fit();
+        client.out.append(
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: text/event-stream\r\n"
+            "Cache-Control: no-cache\r\n"
+            "Transfer-Encoding: chunked\r\n"
+            "Access-Control-Allow-Origin: *\r\n"
+            "\r\n"
+        );
+        send_pending(client);
+    }
+    else if (target == "/api/stats")
+    {
+        respond(client, "200 OK", "application/json", stats_json());
+    }
+    else if (endpoints_.count(target))
+    {
+        std::string body;
+        if (endpoints_[target](query, body))
+        {
+            respond(client, "200 OK", "application/json", body);
+        }
+        else
+        {
+            respond(client, "400 Bad Request", "text/plain", body);
+        }
+    }
+    else
+    {
+        respond(client, "404 Not Found", "text/plain", "Not found\n");
+    }
+}
+
+void StreamServer::respond(client_t& client, const char* status, const char* content_type, const std::string& body)
+{
+    char header[256];
+    int len = snprintf(header, sizeof(header),
+        "HTTP/1.1 %s\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Length: %zu\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "Connection: close\r\n"
+        "\r\n",
+        status, content_type, body.size());
+
+    client.state = CLIENT_CLOSING;
+    client.out.append(header, len);
+    client.out.append(body);
+    send_pending(client);
+}
+
+void StreamServer::flush_clients()
+{
+    const uint64_t now = EventLoop::now_us();
+    const double dt = (now - last_tick_us_) / 1e6;
+    last_tick_us_ = now;
+
+    for (auto& it : clients_)
+    {
+        if (it.second.state == CLIENT_STREAMING)
+        {
+            flush_client(it.second, dt);
+        }
+    }
+
+    // Clients whose send failed are closed, forget them here rather than
+    // while iterating
+    std::vector<int> closed;
+    for (auto& it : clients_)
+    {
+        if (it.second.fd == -1)
+        {
+            closed.push_back(it.first);
+        }
+    }
+    for (int fd : closed)
+    {
+        clients_.erase(fd);
+    }
+}
+
+void StreamServer::flush_client(client_t& client, const double dt)
+{
+    // Frames overwritten in the ring before the client got them are lost
+    const uint64_t oldest = (next_seq_ > STREAM_SERVER_MAX_FRAMES) ? (next_seq_ - STREAM_SERVER_MAX_FRAMES) : 0;
+    if (client.next_seq < oldest)
+    {
+        client.frames_dropped += oldest - client.next_seq;
+        client.next_seq = oldest;
+    }
+
+    const uint64_t available = next_seq_ - client.next_seq;
+    if (available == 0)
+    {
+        return;
+    }
+
+    // Slow client, skip everything until it has drained
+    if ((client.out.size() - client.out_sent) > STREAM_SERVER_MAX_PENDING)
+    {
+        client.frames_dropped += available;
+        client.next_seq = next_seq_;
+        return;
+    }
+
+    // Rate limit, with at most 100 ms worth of burst
+    uint64_t allowed = available;
+    if (client.hz > 0)
+    {
+        client.tokens += client.hz * dt;
+        const double max_tokens = 1 + client.hz * 0.1;
+        if (client.tokens > max_tokens)
+        {
+            client.tokens = max_tokens;
+        }
+        if ((double) allowed > client.tokens)
+        {
+            allowed = (uint64_t) client.tokens;
+        }
+        if (allowed == 0)
+        {
+            return;
+        }
+        client.tokens -= allowed;
+    }
+
+    // Pick allowed frames evenly spread over the available ones, ending at
+    // the newest, and send them as one chunk
+    std::string& out = client.out;
+    const size_t chunk_start = out.size();
+    out.append(16, ' '); // Room for the chunk size line
+
+    for (uint64_t i = 1; i <= allowed; i++)
+    {
+        const uint64_t seq = client.next_seq + (i * available) / allowed - 1;
+        out.append("data: ");
+        out.append(frames_[seq % STREAM_SERVER_MAX_FRAMES].json);
+        out.append("\n\n");
+    }
+    out.append("\r\n");
+
+    const size_t chunk_len = out.size() - chunk_start - 16 - 2;
+    char size_line[17];
+    int len = snprintf(size_line, sizeof(size_line), "%zx\r\n", chunk_len);
+    out.replace(chunk_start, 16, size_line, len);
+
+    client.frames_sent += allowed;
+    client.frames_dropped += available - allowed;
+    client.next_seq = next_seq_;
+
+    send_pending(client);
+}
+
+void StreamServer::send_pending(client_t& client)
+{
+    while (client.out_sent < client.out.size())
+    {
+        ssize_t res = send(client.fd, client.out.data() + client.out_sent,
+                           client.out.size() - client.out_sent, MSG_NOSIGNAL);
+        if (res == -1)
+        {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+            {   // Continue when the socket is writable
+                loop_.modify(client.fd, EPOLLIN | EPOLLOUT);
+                return;
+            }
+            close_client(client);
+            return;
+        }
+        client.out_sent += res;
+    }
+
+    client.out.clear();
+    client.out_sent = 0;
+
+    if (client.state == CLIENT_CLOSING)
+    {
+        close_client(client);
+        return;
+    }
+    loop_.modify(client.fd, EPOLLIN);
+}
+
+void StreamServer::close_client(client_t& client)
+{
+    if (client.fd == -1)
+    {
+        return;
+    }
+    loop_.remove(client.fd);
+    close(client.fd);
+    client.fd = -1;
+}
+
+std::string StreamServer::stats_json() const
+{
+    std::string json;
+    char buf[256];
+
+    snprintf(buf, sizeof(buf), "{\"frames\":%llu,\"clients_total\":%llu,\"clients\":[",
+             (unsigned long long) next_seq_, (unsigned long long) clients_total_);
+    json.append(buf);
+
+    bool first = true;
+    for (const auto& it : clients_)
+    {
+        const client_t& client = it.second;
+        if (client.state != CLIENT_STREAMING)
+        {
+            continue;
+        }
+        snprintf(buf, sizeof(buf), "%s{\"hz\":%g,\"sent\":%llu,\"dropped\":%llu,\"pending\":%zu}",
+                 first ? "" : ",", client.hz,
+                 (unsigned long long) client.frames_sent, (unsigned long long) client.frames_dropped,
+                 client.out.size() - client.out_sent);
+        json.append(buf);
+        first = false;
+    }
+    json.append("]");
+
+    for (const auto& stat : stats_)
+    {
+        json.append(",\"");
+        json.append(stat.first);
+        json.append("\":");
+        json.append(stat.second());
+    }
+
+    json.append("}");
+    return json;
+}
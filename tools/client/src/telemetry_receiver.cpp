@@ -0,0 +1,232 @@
+#include "telemetry_receiver.h"
+#include "vstp.h"
+
+#include "stdio.h"
+#include "string.h"
+#include "errno.h"
+#include "unistd.h"
+#include "fcntl.h"
+#include "arpa/inet.h"
+#include "netinet/in.h"
+#include "sys/socket.h"
+#include "sys/epoll.h"
+
+
+TelemetryReceiver::TelemetryReceiver(EventLoop& loop, const std::string& ip, const int port, const uint16_t node_id)
+    : loop_(loop),
+      ip_(ip),
+      port_(port),
+      node_id_(node_id),
+      sockfd_(-1),
+      connected_(false),
+      retry_timer_(-1),
+      record_file_(NULL),
+      buf_size_(0),
+      bytes_received_(0),
+      records_(0),
+      parse_errors_(0)
+{
+}
+
+TelemetryReceiver::~TelemetryReceiver()
+{
+    if (retry_timer_ != -1)
+    {
+        loop_.remove_timer(retry_timer_);
+    }
+    close_socket();
+    if (record_file_ != NULL)
+    {
+        fclose(record_file_);
+    }
+}
+
+void TelemetryReceiver::add_sink(LogSink* sink)
+{
+    sinks_.push_back(sink);
+}
+
+void TelemetryReceiver::start()
+{
+    try_connect();
+    retry_timer_ = loop_.add_timer(TELEMETRY_RECEIVER_RETRY_DELAY_MS, [this]()
+    {
+        if (sockfd_ == -1)
+        {
+            try_connect();
+        }
+    });
+}
+
+bool TelemetryReceiver::record(const std::string& path)
+{
+    record_file_ = fopen(path.c_str(), "ab");
+    if (record_file_ == NULL)
+    {
+        printf("Failed to open recording %s\n", path.c_str());
+        return false;
+    }
+    printf("Recording telemetry node %d to: %s\n", node_id_, path.c_str());
+    return true;
+}
+
+bool TelemetryReceiver::send_command(const uint8_t cmd)
+{
+    if (!connected_)
+    {
+        return false;
+    }
+    // No payload, so the CRC is cmd ^ len
+    const uint8_t packet[VSTP_PACKET_HEADER_SIZE] = { cmd, 0, cmd };
+    return send(sockfd_, packet, sizeof(packet), MSG_NOSIGNAL) == (ssize_t) sizeof(packet);
+}
+
+void TelemetryReceiver::feed(const uint8_t* data, size_t size)
+{
+    while (size > 0)
+    {
+        size_t n = sizeof(buf_) - buf_size_;
+        if (n > size)
+        {
+            n = size;
+        }
+
+        memcpy(&buf_[buf_size_], data, n);
+        buf_size_ += n;
+        bytes_received_ += n;
+        data += n;
+        size -= n;
+
+        parse();
+    }
+}
+
+void TelemetryReceiver::try_connect()
+{
+    sockfd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sockfd_ == -1)
+    {
+        printf("Failed to open TCP socket\n");
+        return;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr(ip_.c_str());
+    addr.sin_port = htons(port_);
+
+    if ((connect(sockfd_, (struct sockaddr*) &addr, sizeof(addr)) == -1) && (errno != EINPROGRESS))
+    {
+        close(sockfd_);
+        sockfd_ = -1;
+        return;
+    }
+
+    // Writable once connected (or failed)
+    loop_.add(sockfd_, EPOLLIN | EPOLLOUT, [this](uint32_t events) { on_socket_event(events); });
+}
+
+void TelemetryReceiver::on_socket_event(const uint32_t events)
+{
+    if (!connected_)
+    {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(sockfd_, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0)
+        {   // Retried by the timer
+            close_socket();
+            return;
+        }
+
+        connected_ = true;
+        buf_size_ = 0;
+        loop_.modify(sockfd_, EPOLLIN);
+        printf("Connected to telemetry node %d at: %s:%d\n", node_id_, ip_.c_str(), port_);
+    }
+
+    if (!(events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+    {
+        return;
+    }
+
+    ssize_t res = read(sockfd_, &buf_[buf_size_], sizeof(buf_) - buf_size_);
+    if (res > 0)
+    {
+        buf_size_ += res;
+        bytes_received_ += res;
+        parse();
+        if (record_file_ != NULL)
+        {
+            fflush(record_file_);
+        }
+    }
+    else if ((res == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK)))
+    {
+        printf("Telemetry node %d at %s:%d disconnected\n", node_id_, ip_.c_str(), port_);
+        close_socket();
+    }
+}
+
+void TelemetryReceiver::close_socket()
+{
+    if (sockfd_ != -1)
+    {
+        loop_.remove(sockfd_);
+        close(sockfd_);
+        sockfd_ = -1;
+    }
+    connected_ = false;
+}
+
+void TelemetryReceiver::parse()
+{
+    size_t pos = 0;
+
+    while ((buf_size_ - pos) >= sizeof(log_block_header_t))
+    {
+        if (log_block_data_size(buf_[pos]) == 0)
+        {   // Unknown log type, resync on the next byte
+            parse_errors_++;
+            pos++;
+            continue;
+        }
+        if ((buf_size_ - pos) < (sizeof(log_block_header_t) + log_block_data_size(buf_[pos])))
+        {
+            break;
+        }
+
+        // Filtered blocks are followed by the fields of their mask
+        const size_t data_size = log_block_wire_data_size(buf_[pos], &buf_[pos + sizeof(log_block_header_t)]);
+        if ((buf_size_ - pos) < (sizeof(log_block_header_t) + data_size))
+        {
+            break;
+        }
+
+        log_record_t record;
+        record.node = node_id_;
+        memcpy(&record.header, &buf_[pos], sizeof(record.header));
+        record.time_ms = record.header.timestamp;
+        record.data = &buf_[pos + sizeof(log_block_header_t)];
+        record.size = data_size;
+
+        for (LogSink* sink : sinks_)
+        {
+            sink->on_record(record);
+        }
+
+        // Only whole blocks, so a recording survives reconnects
+        if (record_file_ != NULL)
+        {
+            fwrite(&buf_[pos], 1, sizeof(log_block_header_t) + data_size, record_file_);
+        }
+
+        records_++;
+        pos += sizeof(log_block_header_t) + data_size;
+    }
+
+    // Keep the incomplete tail for the next read
+    memmove(buf_, &buf_[pos], buf_size_ - pos);
+    buf_size_ -= pos;
+}
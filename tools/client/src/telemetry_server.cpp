@@ -0,0 +1,227 @@
+/*
+ * Native live-streaming server for telemetry dashboards.
+ *
+ * Receives log blocks from one or more telemetry nodes, merges them into
+ * one time ordered stream and streams it to any number of browsers, see
+ * stream_server.h for the HTTP API and aggregator.h for the merging.
+ * Every field is also kept in a decimation pyramid for zooming, served as
+ * GET /api/range, see decimation_pyramid.h. GET /api/command forwards the
+ * profiler commands to a node, over the connection it streams on.
+ *
+ * Usage: telemetry_server [-l <http port, default 9090>] [-w <reorder window ms>]
+ *                         [-r <recording prefix>] <node ip>[:port] [<node ip>[:port] ...]
+ *        telemetry_server [-l <http port>] <node ip> <node port>
+ *        telemetry_server [-l <http port>] -R <recording> [<recording> ...]
+ * The node port defaults to 80. With -r, the stream of node N is recorded to
+ * <prefix>.N.vstp. With -R, recordings are loaded in full (on the node clock)
+ * and served on /api/range.
+ */
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "ctype.h"
+#include "unistd.h"
+#include "signal.h"
+
+#include <string>
+
+#include "event_loop.h"
+#include "aggregator.h"
+#include "decimation_pyramid.h"
+#include "stream_server.h"
+#include "telemetry_receiver.h"
+#include "vstp.h"
+
+
+static bool is_number(const char* s)
+{
+    for (; *s; s++)
+    {
+        if (!isdigit((unsigned char) *s))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Feeds a recording to the sink, as node node_id. Returns false if it can't be read. */
+static bool replay(EventLoop& loop, const char* path, const uint16_t node_id, LogSink* sink)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        printf("Failed to open recording %s\n", path);
+        return false;
+    }
+
+    TelemetryReceiver receiver(loop, path, 0, node_id);
+    receiver.add_sink(sink);
+
+    const uint64_t t0 = EventLoop::now_us();
+    uint8_t buf[64 * 1024];
+    size_t size;
+    while ((size = fread(buf, 1, sizeof(buf), file)) > 0)
+    {
+        receiver.feed(buf, size);
+    }
+    fclose(file);
+
+    printf("Replayed %s as node %u: %llu records in %.0f ms\n", path, (unsigned) node_id,
+           (unsigned long long) receiver.records(), (EventLoop::now_us() - t0) / 1000.0);
+    return true;
+}
+
+/*
+ * GET /api/command?cmd=<profile_dump|profile_reset>[&node=<id>]: the node
+ * reads upstream commands only when built with VSTP_PROFILE, and the
+ * profile comes back as profile_phase records in the stream.
+ */
+static bool command_json(Aggregator& aggregator, const std::string& query, std::string& body)
+{
+    std::string name;
+    std::string value;
+    StreamServer::query_param(query, "cmd", name);
+    const uint16_t node = StreamServer::query_param(query, "node", value) ? (uint16_t) atoi(value.c_str()) : 0;
+
+    uint8_t cmd;
+    if (name == "profile_dump")
+    {
+        cmd = VSTP_CMD_PROFILE_DUMP;
+    }
+    else if (name == "profile_reset")
+    {
+        cmd = VSTP_CMD_PROFILE_RESET;
+    }
+    else
+    {
+        body = "Unknown cmd=" + name + ", expected profile_dump or profile_reset\n";
+        return false;
+    }
+
+    if (!aggregator.send_command(node, cmd))
+    {
+        body = "Node " + std::to_string(node) + " is not connected\n";
+        return false;
+    }
+
+    char buf[128];
+    snprintf(buf, sizeof(buf), "{\"node\":%u,\"cmd\":\"%s\"}", (unsigned) node, name.c_str());
+    body = buf;
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    int http_port = 9090;
+    uint32_t window_ms = AGGREGATOR_REORDER_WINDOW_MS;
+    const char* record_prefix = NULL;
+    bool replay_mode = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "l:w:r:R")) != -1)
+    {
+        switch (opt)
+        {
+            case 'l': http_port = atoi(optarg); break;
+            case 'w': window_ms = atoi(optarg); break;
+            case 'r': record_prefix = optarg; break;
+            case 'R': replay_mode = true; break;
+            default:
+                printf("Usage: %s [-l http_port] [-w reorder_window_ms] [-r recording_prefix] <node ip>[:port] ...\n"
+                       "       %s [-l http_port] -R <recording> ...\n", argv[0], argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind >= argc)
+    {
+        printf(replay_mode ? "Must supply a recording\n" : "Must supply IP of telemetry node\n");
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    EventLoop loop;
+
+    if (replay_mode)
+    {
+        // Recordings are read in full, so keep every sample
+        PyramidSink pyramid(PYRAMID_UNBOUNDED);
+        for (int i = optind; i < argc; i++)
+        {
+            if (!replay(loop, argv[i], i - optind, &pyramid))
+            {
+                return 1;
+            }
+        }
+        pyramid.shrink_to_fit();
+
+        StreamServer server(loop, http_port);
+        if (!server.start())
+        {
+            return 1;
+        }
+        server.add_stats("pyramid", [&pyramid]() { return pyramid.stats_json(); });
+        server.add_endpoint("/api/range", [&pyramid](const std::string& query, std::string& body)
+        {
+            return pyramid.query_json(query, body);
+        });
+
+        loop.run();
+        return 0;
+    }
+
+    Aggregator aggregator(loop, window_ms);
+    PyramidSink pyramid;
+
+    if ((argc - optind == 2) && is_number(argv[optind + 1]))
+    {   // <node ip> <node port>
+        aggregator.add_node(argv[optind], atoi(argv[optind + 1]));
+    }
+    else
+    {
+        for (int i = optind; i < argc; i++)
+        {
+            const char* colon = strchr(argv[i], ':');
+            if (colon == NULL)
+            {
+                aggregator.add_node(argv[i], 80);
+            }
+            else
+            {
+                aggregator.add_node(std::string(argv[i], colon - argv[i]), atoi(colon + 1));
+            }
+        }
+    }
+
+    StreamServer server(loop, http_port);
+    if (!server.start())
+    {
+        return 1;
+    }
+    server.add_stats("nodes", [&aggregator]() { return aggregator.metrics_json(); });
+    server.add_stats("pyramid", [&pyramid]() { return pyramid.stats_json(); });
+    server.add_endpoint("/api/range", [&pyramid](const std::string& query, std::string& body)
+    {
+        return pyramid.query_json(query, body);
+    });
+
+    server.add_endpoint("/api/command", [&aggregator](const std::string& query, std::string& body)
+    {
+        return command_json(aggregator, query, body);
+    });
+
+    if ((record_prefix != NULL) && !aggregator.record(record_prefix))
+    {
+        return 1;
+    }
+
+    aggregator.add_sink(&server);
+    aggregator.add_sink(&pyramid);
+    aggregator.start();
+
+    loop.run();
+
+    return 0;
+}
@@ -7,9 +7,10 @@ from enum import IntEnum
 import struct
 from queue import Queue
 import os
+import math
 
 
-from log_types import log_block_data_control_loop_t, log_block_header_t, log_type_t
+from log_types import LOG_BLOCK_FILTERED, LOG_BLOCK_TYPES, filtered_fmt, filtered_names, log_block_data_control_loop_t, log_block_header_t, log_type_t
 from telemetry_client_logger import TelemetryClientLogger
 
 LOG_TYPE_PID = 0
@@ -82,25 +83,33 @@ class TelemetryClient:
 
             # Parse log header
             try:
-                header_raw = self.sock.recv(log_block_header_t.size)
+                header_raw = self._recv_exact(log_block_header_t.size)
                 header_args = struct.unpack(log_block_header_t.fmt, header_raw)
                 header = log_block_header_t(*header_args)
                 #print(f'New log block received: {header}')
 
-                log_block: log_type_t
-
-                if header.type == log_type_t.LOG_TYPE_PID:
-                    data_raw = self.sock.recv(log_block_data_control_loop_t.size)
-                    data_args = struct.unpack(log_block_data_control_loop_t.fmt, data_raw)
-                    log_block = log_block_data_control_loop_t(*(header_args + data_args))
-                else:
+                block_type = LOG_BLOCK_TYPES.get(header.type)
+                if block_type is None:
                     print(f'No support for log types {header.type} yet!')
                     continue
 
+                data_raw = self._recv_exact(block_type.size)
+                data_args = struct.unpack(block_type.fmt, data_raw)
+                log_block = block_type(*(header_args + data_args))
+
+                full_type = LOG_BLOCK_FILTERED.get(header.type)
+                if full_type is not None:
+                    # Only the fields of the mask follow, the others are NaN
+                    fmt = filtered_fmt(full_type, log_block.field_mask)
+                    filtered_raw = self._recv_exact(struct.calcsize(fmt))
+                    values = dict(zip(filtered_names(full_type, log_block.field_mask), struct.unpack(fmt, filtered_raw)))
+                    log_block = full_type(*header_args, **{name: values.get(name, math.nan) for name in full_type.names})
+                    i += len(filtered_raw)
+
                 self.logger.log(log_block)
                 self._rx.put(log_block)
 
-                i += log_block_header_t.size + log_block_data_control_loop_t.size
+                i += log_block_header_t.size + block_type.size
 
                 if (time.time() - t0) >= 1:
                     t0 = time.time()
@@ -110,9 +119,23 @@ class TelemetryClient:
 
             except struct.error:
                 print('err')
+            except ConnectionError as e:
+                print(f'Connection lost: {e}')
+                self.sock.close()
+                self.sock = None
 
         print('Telem client thread ended')
 
+    def _recv_exact(self, size: int) -> bytes:
+        ''' Reads exactly size bytes, since log blocks may be split over several TCP segments. '''
+        buf = b''
+        while len(buf) < size:
+            chunk = self.sock.recv(size - len(buf))
+            if not chunk:
+                raise ConnectionError('Telemetry node closed the connection')
+            buf += chunk
+        return buf
+
     def _connect(self) -> None:
         try:
             sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
@@ -1,4 +1,4 @@
-from log_types import log_block_data_control_loop_t, log_block_header_t, log_type_t
+from log_types import log_block_data_control_loop_t, log_block_data_link_mode_t, log_block_header_t, log_link_mode_t, log_type_t
 
 
 DESIRED_LOG_PARAMS = [
@@ -11,6 +11,13 @@ DESIRED_LOG_PARAMS = [
 class TelemetryClientLogger:
 
     def log(self, log_block: log_block_data_control_loop_t) -> None:
+        if isinstance(log_block, log_block_data_link_mode_t):
+            print(f'[{log_block.id}] Link mode: {log_link_mode_t(log_block.mode).name}, '
+                  f'ring: {log_block.ring_used}/{log_block.ring_size} B, '
+                  f'in: {log_block.input_rate} B/s, out: {log_block.drain_rate} B/s')
+            return
+        if not isinstance(log_block, log_block_data_control_loop_t):
+            return
         print(f'[{log_block.id}] ', end='')
         for param in DESIRED_LOG_PARAMS:
             print(f'{param}: {getattr(log_block, param)}', end=' ')
@@ -9,11 +9,16 @@ from pathlib import Path
 
 
 class VSTP_Cmd(IntEnum):
-    LOG_START = 0
-    LOG_STOP = 1
-    LOG_DATA = 2
-    LOG_SD_START = 3
-    LOG_SD_STOP = 4
+    # Must match vstp_cmd_t in include/vstp.h
+    LOG_START = 1
+    LOG_STOP = 2
+    LOG_DATA = 3
+    LOG_SD_START = 4
+    LOG_SD_STOP = 5
+    RESET = 6
+    PROFILE_DUMP = 7
+    PROFILE_RESET = 8
+    LOG_FILTER = 9
 
 @dataclass
 class VSTP_Packet:
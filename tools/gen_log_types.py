@@ -0,0 +1,172 @@
+'''
+Generates tools/client/log_types.py from the log block schema in
+include/log_schema_def.h, so that the Python struct formats always match
+the C/C++ types in include/log_schema.h.
+
+Usage: python3 gen_log_types.py [schema] [output]
+'''
+import re
+import sys
+from pathlib import Path
+from typing import Dict, List, Tuple
+
+
+ROOT = Path(__file__).absolute().parent.parent
+DEFAULT_SCHEMA = ROOT.joinpath('include', 'log_schema_def.h')
+DEFAULT_OUTPUT = ROOT.joinpath('tools', 'client', 'log_types.py')
+
+# C type -> (struct format character, size in bytes)
+C_TYPES = {
+    'bool':     ('?', 1),
+    'uint8_t':  ('B', 1),
+    'int8_t':   ('b', 1),
+    'uint16_t': ('H', 2),
+    'int16_t':  ('h', 2),
+    'uint32_t': ('I', 4),
+    'int32_t':  ('i', 4),
+    'uint64_t': ('Q', 8),
+    'int64_t':  ('q', 8),
+    'float':    ('f', 4),
+    'double':   ('d', 8),
+}
+
+Field = Tuple[str, str] # (C type, name)
+
+RE_DEFINE = re.compile(r'#define\s+(\w+)\(\w+\)((?:[^\n]*\\\n)*[^\n]*)')
+RE_FIELD = re.compile(r'F\(\s*(\w+)\s*,\s*(\w+)\s*\)|LOG_SCHEMA_FIELDS_(\w+)\(F\)')
+RE_BLOCK = re.compile(r'X\(\s*(\w+)\s*,\s*(\w+)\s*,\s*(\d+)\s*\)')
+RE_ENUM = re.compile(r'E\(\s*(\w+)\s*,\s*(\w+)\s*,\s*(\d+)\s*\)')
+RE_FILTERED = re.compile(r'FX\(\s*(\w+)\s*,\s*(\w+)\s*,\s*(\w+)\s*\)')
+
+
+def parse_enums(text: str) -> Dict[str, List[Tuple[str, int]]]:
+    ''' Returns the values of each enum in LOG_SCHEMA_ENUMS, as (name, value). '''
+    macros = {name: body for name, body in RE_DEFINE.findall(text)}
+    enums = {}
+    for enum, name, value in RE_ENUM.findall(macros.get('LOG_SCHEMA_ENUMS', '')):
+        enums.setdefault(enum, []).append((name, int(value)))
+    return enums
+
+
+def parse_filtered(text: str) -> List[Tuple[str, str, str]]:
+    ''' Returns the blocks in LOG_SCHEMA_FILTERED, as (name, log type, full block). '''
+    macros = {name: body for name, body in RE_DEFINE.findall(text)}
+    return RE_FILTERED.findall(macros.get('LOG_SCHEMA_FILTERED', ''))
+
+
+def parse_schema(text: str) -> Tuple[List[Tuple[str, str, int]], Dict[str, List[Field]]]:
+    ''' Returns the blocks as (name, log type, value) and the fields of each block. '''
+    macros = {name: body for name, body in RE_DEFINE.findall(text)}
+
+    blocks = [(name, log_type, int(value))
+              for name, log_type, value in RE_BLOCK.findall(macros['LOG_SCHEMA_BLOCKS'])]
+
+    def expand(block: str) -> List[Field]:
+        fields = []
+        for ctype, name, include in RE_FIELD.findall(macros[f'LOG_SCHEMA_FIELDS_{block}']):
+            if include:
+                fields += expand(include)
+            else:
+                if ctype not in C_TYPES:
+                    raise ValueError(f'Unsupported type "{ctype}" for field {block}.{name}')
+                fields.append((ctype, name))
+        return fields
+
+    block_fields = {name: expand(name) for name in ['header'] + [b[0] for b in blocks]}
+    return blocks, block_fields
+
+
+def fmt_of(fields: List[Field]) -> str:
+    return '<' + ''.join(C_TYPES[ctype][0] for ctype, _ in fields)
+
+
+def size_of(fields: List[Field]) -> int:
+    return sum(C_TYPES[ctype][1] for ctype, _ in fields)
+
+
+def gen_class(name: str, base: str, fields: List[Field], is_header: bool) -> str:
+    lines = [
+        '@dataclass',
+        f'class {name}({base}):',
+    ]
+    lines += [f'    {field}: float = 0 # {ctype}' for ctype, field in fields]
+    lines += [
+        '',
+        f"    fmt = '{fmt_of(fields)}'",
+        '    size = struct.calcsize(fmt)',
+        f"    names = {tuple(field for _, field in fields)!r}",
+        '',
+        '    def to_bytes(self) -> bytes:',
+        f'        """ Returns a {name} in bytes. """',
+        '        fmt = self.fmt',
+    ]
+    if not is_header:
+        lines.append('        fmt = super().fmt + fmt.replace("<", "")')
+    lines += [
+        '        raw = struct.pack(fmt, *[getattr(self, f.name) for f in fields(self)])',
+        '        return raw',
+        '',
+        f'assert {name}.size == {size_of(fields)}',
+        '',
+    ]
+    return '\n'.join(lines)
+
+
+def generate(schema: Path) -> str:
+    text = schema.read_text()
+    blocks, block_fields = parse_schema(text)
+
+    out = [
+        f'# Generated by tools/gen_log_types.py from include/{schema.name}.',
+        '# Do not edit by hand, run `make -C tools/client log_types` instead.',
+        'from dataclasses import dataclass, fields',
+        'import struct',
+        'from enum import IntEnum',
+        '',
+        '@dataclass',
+        'class log_block_t:',
+        '    pass',
+        '',
+        'class log_type_t(IntEnum):',
+    ]
+    out += [f'    {log_type} = {value}' for _, log_type, value in blocks]
+    out.append('')
+    for enum, values in parse_enums(text).items():
+        out.append(f'class {enum}(IntEnum):')
+        out += [f'    {name} = {value}' for name, value in values]
+        out.append('')
+    out.append(gen_class('log_block_header_t', 'log_block_t', block_fields['header'], True))
+    for name, _, _ in blocks:
+        out.append(gen_class(f'log_block_data_{name}_t', 'log_block_header_t', block_fields[name], False))
+
+    out.append('# Log type -> data class, for decoding a stream of log blocks')
+    out.append('LOG_BLOCK_TYPES = {')
+    out += [f'    log_type_t.{log_type}: log_block_data_{name}_t,' for name, log_type, _ in blocks]
+    out.append('}')
+    out.append('')
+
+    out.append('# Log type of a filtered block -> data class of its full block. A filtered')
+    out.append('# block is followed by the fields of its field_mask, see filtered_fmt().')
+    out.append('LOG_BLOCK_FILTERED = {')
+    out += [f'    log_type_t.{log_type}: log_block_data_{full}_t,' for _, log_type, full in parse_filtered(text)]
+    out.append('}')
+    out.append('')
+    out += [
+        'def filtered_fmt(block: type, field_mask: int) -> str:',
+        '    """ Returns the struct format of the fields of block in field_mask. """',
+        "    return '<' + ''.join(c for i, c in enumerate(block.fmt[1:]) if field_mask & (1 << i))",
+        '',
+        'def filtered_names(block: type, field_mask: int) -> tuple:',
+        '    """ Returns the names of the fields of block in field_mask. """',
+        '    return tuple(name for i, name in enumerate(block.names) if field_mask & (1 << i))',
+        '',
+    ]
+    return '\n'.join(out)
+
+
+if __name__ == '__main__':
+    schema = Path(sys.argv[1]) if len(sys.argv) > 1 else DEFAULT_SCHEMA
+    output = Path(sys.argv[2]) if len(sys.argv) > 2 else DEFAULT_OUTPUT
+
+    output.write_text(generate(schema))
+    print(f'Generated {output} from {schema}')
@@ -0,0 +1,177 @@
+#ifndef HOST_POLICIES_H
+#define HOST_POLICIES_H
+
+/*
+ * VstpNode I/O policies for running the node on a PC: the flight controller
+ * stream is read from a file descriptor (stdin, a FIFO or a pty from e.g.
+ * socat) and clients connect to a local TCP server.
+ */
+
+#include "stdint.h"
+#include "stddef.h"
+#include "errno.h"
+#include "fcntl.h"
+#include "unistd.h"
+#include "string.h"
+#include "netinet/in.h"
+#include "netinet/tcp.h"
+#include "sys/socket.h"
+
+
+// Send buffer of the client socket. Kept small, like the TCP send buffer of
+// lwIP on the ESP8266, so that a slow client backs up into the RX ring
+// instead of into the kernel.
+#define HOST_NODE_SNDBUF 4096
+
+
+class FdUart
+{
+public:
+    /* Returns false if the file could not be opened */
+    bool open(const char* path)
+    {
+        fd_ = (strcmp(path, "-") == 0) ? STDIN_FILENO : ::open(path, O_RDONLY | O_NONBLOCK);
+        if (fd_ == -1)
+        {
+            return false;
+        }
+        fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);
+        return true;
+    }
+
+    int fd() const { return fd_; }
+
+    /*
+     * True after the writer went away (EOF, e.g. at the end of a piped
+     * stream) or the fd failed, until data arrives again, e.g. from the
+     * next writer of a FIFO
+     */
+    bool closed() const { return closed_; }
+
+    inline int read()
+    {
+        if (pos_ == size_)
+        {
+            // Refill, like the UART FIFO of the ESP8266
+            const ssize_t res = ::read(fd_, buf_, sizeof(buf_));
+            if (res <= 0)
+            {
+                closed_ = (res == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR));
+                return -1;
+            }
+            closed_ = false;
+            pos_ = 0;
+            size_ = (size_t) res;
+        }
+        return buf_[pos_++];
+    }
+
+private:
+    int     fd_ = -1;
+    bool    closed_ = false;
+    size_t  pos_ = 0;
+    size_t  size_ = 0;
+    uint8_t buf_[256];
+};
+
+class TcpServerTransport
+{
+public:
+    void set_port(const uint16_t port) { port_ = port; }
+
+    inline bool poll()
+    {
+        if (server_fd_ == -1)
+        {
+            begin();
+            return true;
+        }
+        return false;
+    }
+
+    inline bool connected()
+    {
+        return client_fd_ != -1;
+    }
+
+    inline bool accept()
+    {
+        if (server_fd_ == -1)
+        {
+            return false;
+        }
+        client_fd_ = ::accept4(server_fd_, NULL, NULL, SOCK_NONBLOCK);
+        if (client_fd_ != -1)
+        {
+            int nodelay = 1;
+            setsockopt(client_fd_, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+            int sndbuf = HOST_NODE_SNDBUF;
+            setsockopt(client_fd_, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+        }
+        return client_fd_ != -1;
+    }
+
+    inline int read()
+    {
+        uint8_t byte;
+        const ssize_t res = ::recv(client_fd_, &byte, 1, MSG_DONTWAIT);
+        if (res == 1)
+        {
+            return byte;
+        }
+        if ((res == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK)))
+        {   // Client is gone
+            ::close(client_fd_);
+            client_fd_ = -1;
+        }
+        return -1;
+    }
+
+    inline size_t write(const uint8_t* data, const size_t size)
+    {
+        const ssize_t res = ::send(client_fd_, data, size, MSG_NOSIGNAL);
+        if (res >= 0)
+        {
+            return (size_t) res;
+        }
+        if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+        {   // Client is gone
+            ::close(client_fd_);
+            client_fd_ = -1;
+        }
+        return 0;
+    }
+
+private:
+    void begin()
+    {
+        server_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (server_fd_ == -1)
+        {
+            return;
+        }
+
+        int reuse = 1;
+        setsockopt(server_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port_);
+
+        if ((bind(server_fd_, (struct sockaddr*) &addr, sizeof(addr)) == -1) ||
+            (listen(server_fd_, 1) == -1))
+        {
+            ::close(server_fd_);
+            server_fd_ = -1;
+        }
+    }
+
+    uint16_t port_ = 8080;
+    int      server_fd_ = -1;
+    int      client_fd_ = -1;
+};
+
+
+#endif /* HOST_POLICIES_H */
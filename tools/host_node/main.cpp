@@ -0,0 +1,136 @@
+/*
+ * Host build of the telemetry node.
+ *
+ * Runs the same VstpNode as the firmware, but reads the flight controller
+ * stream from a file descriptor and serves clients on a local TCP port.
+ * Useful as a stand-in node when developing and benchmarking the host tools.
+ *
+ * With -s, the ring occupancy, discarded packets and link mode are written
+ * to a CSV file every HOST_NODE_STATS_PERIOD_US, with CLOCK_MONOTONIC times
+ * like tools/client/link_proxy, for tools/link_report.py.
+ *
+ * Usage: host_node [-u <uart path, default stdin>] [-p <port, default 8080>] [-s <stats csv>]
+ */
+#include "vstp_node.h"
+#include "host_policies.h"
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "inttypes.h"
+#include "poll.h"
+#include "time.h"
+
+
+// Node variant, override with -D like in platformio.ini
+#ifndef VSTP_NODE_RING_BYTES
+    #define VSTP_NODE_RING_BYTES  16384
+#endif
+#ifndef VSTP_NODE_MAX_PAYLOAD
+    #define VSTP_NODE_MAX_PAYLOAD VSTP_PACKET_MAX_PAYLOAD_SIZE
+#endif
+
+#define HOST_NODE_STATS_PERIOD_US 10000
+
+typedef VstpNode<
+    FdUart,
+    TcpServerTransport,
+    VSTP_NODE_RING_BYTES,
+    VSTP_NODE_MAX_PAYLOAD
+> vstp_node_t;
+
+static vstp_node_t vstp_node;
+
+
+static uint64_t now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void write_stats(FILE* file, const uint64_t t_us)
+{
+    fprintf(file, "%" PRIu64 ",%zu,%zu,%zu,%u,%u,%" PRIu32 ",%" PRIu32 ",%d\n",
+            t_us, vstp_node.ring_used(), vstp_node_t::ring_bytes, vstp_node.ring_packets(),
+            (unsigned) vstp_node.discarded_packets(), (unsigned) vstp_node.link_mode(),
+            vstp_node.input_rate(), vstp_node.drain_rate(), vstp_node.transport().connected() ? 1 : 0);
+}
+
+
+int main(int argc, char* argv[])
+{
+    const char* uart_path = "-";
+    const char* stats_path = NULL;
+    int port = 8080;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "u:p:s:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'u': uart_path = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 's': stats_path = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [-u uart_path] [-p port] [-s stats_csv]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (!vstp_node.uart().open(uart_path))
+    {
+        fprintf(stderr, "Failed to open %s\n", uart_path);
+        return 1;
+    }
+    vstp_node.transport().set_port(port);
+
+    FILE* stats_file = NULL;
+    if (stats_path != NULL)
+    {
+        stats_file = fopen(stats_path, "w");
+        if (stats_file == NULL)
+        {
+            fprintf(stderr, "Failed to open %s\n", stats_path);
+            return 1;
+        }
+        // Line buffered, so the file is complete when the node is killed
+        setvbuf(stats_file, NULL, _IOLBF, 0);
+        fprintf(stats_file, "time_us,ring_used,ring_size,ring_packets,discarded_packets,link_mode,"
+                            "input_rate,drain_rate,connected\n");
+    }
+    uint64_t t_stats = 0;
+    bool uart_closed = false;
+
+    fprintf(stderr, "VSTP node: %zu B RAM (%zu B ring, %zu B max payload), UART: %s, port: %d\n",
+            sizeof(vstp_node), vstp_node_t::ring_bytes, vstp_node_t::max_payload, uart_path, port);
+
+    while (1)
+    {
+        if (stats_file != NULL)
+        {
+            const uint64_t t = now_us();
+            if ((t - t_stats) >= HOST_NODE_STATS_PERIOD_US)
+            {
+                write_stats(stats_file, t);
+                t_stats = t;
+            }
+        }
+
+        if (vstp_node.uart().closed() != uart_closed)
+        {
+            uart_closed = vstp_node.uart().closed();
+            fputs(uart_closed ? "UART closed, still serving clients\n" : "UART data again\n", stderr);
+        }
+
+        if (!vstp_node.update())
+        {
+            // Nothing to do, wait a bit for UART data instead of spinning.
+            // A closed UART polls as POLLHUP right away, so then only sleep
+            // for the tick, the node still reads it once per tick.
+            struct pollfd pfd = { vstp_node.uart().fd(), POLLIN, 0 };
+            ::poll(&pfd, vstp_node.uart().closed() ? 0 : 1, 1);
+        }
+    }
+
+    return 0;
+}
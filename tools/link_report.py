@@ -0,0 +1,170 @@
+'''
+Summarizes a run through the link emulator (tools/client/link_proxy), per
+timeline segment and as curves over time:
+ - throughput from the node, in kB/s by arrival time
+ - packet delay through the link (p50/p99), lost/retransmitted packets and
+   TCP timeouts, where a segment ran out of retries and the connection
+   was dropped
+ - with --stats, the RX ring occupancy, discarded packets and link mode of
+   host_node -s
+
+Usage: python3 link_report.py <arrivals csv> [--stats <host_node stats csv>] [--bin <ms>] [--csv <curves csv>]
+  --bin  width of a curve bin, default 1000 ms
+  --csv  also writes the curves to a CSV file, e.g. for plotting
+'''
+import csv
+import sys
+from dataclasses import dataclass, field
+
+# Must match log_link_mode_t in include/log_schema_def.h
+LINK_MODES = {0: 'full', 1: 'summary'}
+
+
+@dataclass
+class Bin:
+    bytes: int = 0
+    packets: int = 0
+    lost: int = 0
+    retransmits: int = 0
+    timeouts: int = 0
+    delays: list = field(default_factory=list)
+    ring_pct: list = field(default_factory=list)
+    discarded: int = 0
+    link_mode: int = None
+
+
+def percentile(values: list, p: float) -> float:
+    if not values:
+        return float('nan')
+    values = sorted(values)
+    return values[min(len(values) - 1, int(p / 100 * len(values)))]
+
+
+def read_arrivals(path: str) -> list:
+    with open(path) as f:
+        return [{
+            'read_us': int(row['read_us']),
+            'arrival_us': int(row['arrival_us']) if row['arrival_us'] else None,
+            'from': row['from'],
+            'bytes': int(row['bytes']),
+            'lost': row['lost'] == '1',
+            'retransmits': int(row['retransmits']),
+            'segment': int(row['segment']),
+            'timeout': row['timeout'] == '1',
+        } for row in csv.DictReader(f)]
+
+
+def read_stats(path: str) -> list:
+    with open(path) as f:
+        rows = [{k: int(v) for k, v in row.items()} for row in csv.DictReader(f)]
+    # discarded_packets is a 16 bit counter
+    total = 0
+    for prev, row in zip([None] + rows[:-1], rows):
+        if prev is not None:
+            total += (row['discarded_packets'] - prev['discarded_packets']) & 0xFFFF
+        row['discarded'] = total
+    return rows
+
+
+def add_packet(b: Bin, packet: dict) -> None:
+    b.packets += 1
+    b.lost += packet['lost']
+    b.retransmits += packet['retransmits']
+    b.timeouts += packet['timeout']
+    if not packet['lost']:
+        b.bytes += packet['bytes']
+        b.delays.append((packet['arrival_us'] - packet['read_us']) / 1000)
+
+
+def add_stats(b: Bin, row: dict, discarded: int) -> None:
+    b.ring_pct.append(100 * row['ring_used'] / row['ring_size'])
+    b.discarded += discarded
+    b.link_mode = max(row['link_mode'], b.link_mode or 0)
+
+
+def format_bin(b: Bin, duration_s: float) -> list:
+    ring = [f'{sum(b.ring_pct) / len(b.ring_pct):.0f}', f'{max(b.ring_pct):.0f}'] if b.ring_pct else ['', '']
+    return [f'{b.bytes / 1000 / duration_s:.1f}' if duration_s > 0 else '',
+            f'{percentile(b.delays, 50):.1f}', f'{percentile(b.delays, 99):.1f}',
+            b.packets, b.lost, b.retransmits, b.timeouts] + ring + [b.discarded, LINK_MODES.get(b.link_mode, '')]
+
+
+def print_table(header: list, rows: list) -> None:
+    widths = [max(len(str(v)) for v in col) for col in zip(header, *rows)]
+    for row in [header] + rows:
+        print('  '.join(str(v).rjust(w) for v, w in zip(row, widths)))
+
+
+if __name__ == '__main__':
+    args = [a for a in sys.argv[1:]]
+    if not args or args[0].startswith('--'):
+        print(__doc__)
+        sys.exit(1)
+
+    def option(name: str, default=None):
+        return args[args.index(name) + 1] if name in args else default
+
+    arrivals = read_arrivals(args[0])
+    stats = read_stats(option('--stats')) if option('--stats') else []
+    bin_us = int(float(option('--bin', 1000)) * 1000)
+
+    node = [p for p in arrivals if p['from'] == 'node']
+    if not node:
+        print('No packets from the node')
+        sys.exit(1)
+
+    # The emulator marks where each timeline segment starts, times are
+    # relative to its start like in the timeline
+    seg_start = {p['segment']: p['read_us'] for p in arrivals if p['from'] == 'link'}
+    t0 = seg_start[0]
+    stats = [s for s in stats if s['time_us'] >= t0]
+    t_end = max([p['arrival_us'] or p['read_us'] for p in arrivals] + [s['time_us'] for s in stats])
+    seg_ids = sorted(seg_start)
+    seg_end = {s: (seg_start[n] if n is not None else t_end)
+               for s, n in zip(seg_ids, seg_ids[1:] + [None])}
+
+    def segment_at(t_us: int):
+        for s in reversed(seg_ids):
+            if t_us >= seg_start[s]:
+                return s
+        return None
+
+    segments = {s: Bin() for s in seg_ids}
+    bins = [Bin() for _ in range((t_end - t0) // bin_us + 1)]
+
+    for p in node:
+        add_packet(segments[p['segment']], p)
+        add_packet(bins[((p['arrival_us'] or p['read_us']) - t0) // bin_us], p)
+
+    prev_discarded = 0
+    for row in stats:
+        discarded = row['discarded'] - prev_discarded
+        prev_discarded = row['discarded']
+        add_stats(bins[(row['time_us'] - t0) // bin_us], row, discarded)
+        s = segment_at(row['time_us'])
+        if s is not None:
+            add_stats(segments[s], row, discarded)
+
+    up = [p for p in arrivals if p['from'] == 'client']
+    timeouts = sum(p['timeout'] for p in arrivals)
+    print(f'{len(node)} packets from the node, {len(up)} from the client, '
+          f'{(t_end - t0) / 1e6:.1f} s, {timeouts} TCP timeouts')
+    print()
+
+    header = ['kB/s', 'p50 ms', 'p99 ms', 'packets', 'lost', 'retx', 'timeouts', 'ring %', 'max %', 'discarded', 'mode']
+    print('Per timeline segment:')
+    print_table(['segment', 'start s', 'length s'] + header,
+                [[s, f'{(seg_start[s] - t0) / 1e6:.1f}', f'{(seg_end[s] - seg_start[s]) / 1e6:.1f}']
+                 + format_bin(segments[s], (seg_end[s] - seg_start[s]) / 1e6) for s in seg_ids])
+    print()
+
+    curves = [[f'{i * bin_us / 1e6:.1f}'] + format_bin(b, bin_us / 1e6) for i, b in enumerate(bins)]
+    print(f'Per {bin_us / 1000:g} ms:')
+    print_table(['t s'] + header, curves)
+
+    if option('--csv'):
+        with open(option('--csv'), 'w', newline='') as f:
+            writer = csv.writer(f)
+            writer.writerow(['t_s', 'kB_per_s', 'delay_p50_ms', 'delay_p99_ms', 'packets', 'lost', 'retransmits',
+                             'timeouts', 'ring_mean_pct', 'ring_max_pct', 'discarded', 'link_mode'])
+            writer.writerows(curves)
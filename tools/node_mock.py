@@ -0,0 +1,105 @@
+'''
+Stand-in for a telemetry node: a TCP server that streams generated
+log_block_data_control_loop_t blocks, like a node with an FC attached.
+
+The FC clock and the link can be made imperfect, to exercise the merge of
+several nodes (see tools/test_aggregator.py):
+  --skew S          FC clock runs S times too fast (e.g. 0.05) or slow (-0.05)
+  --clock-offset MS FC clock starts at MS instead of 0
+  --stall MS        once a second, the link holds everything for MS, then
+                    delivers it in one burst, like WiFi retries
+  --reset-after S   FC reboots after S seconds: timestamps and ids restart at 0
+
+Usage: python3 node_mock.py [port] [blocks per second] [node id] [options]
+'''
+import argparse
+import math
+import socket
+import time
+from collections import deque
+
+from client.log_types import log_block_data_control_loop_t, log_type_t
+
+
+class NodeMock:
+
+    def __init__(self, port: int, rate: float, node_id: int = 0, skew: float = 0, clock_offset_ms: int = 0,
+                 stall_ms: float = 0, reset_after_s: float = None) -> None:
+        self.port = port
+        self.rate = rate
+        self.node_id = node_id
+        self.skew = skew
+        self.clock_offset_ms = clock_offset_ms
+        self.stall_ms = stall_ms
+        self.reset_after_s = reset_after_s
+        self.t0 = time.monotonic()
+        self.t0_clock = self.t0
+        self.id = 0
+
+    def gen_block(self) -> bytes:
+        now = time.monotonic()
+        if (self.reset_after_s is not None) and (now - self.t0 >= self.reset_after_s):
+            # FC reboot, its clock and ids start over
+            self.reset_after_s = None
+            self.t0_clock = now
+            self.clock_offset_ms = 0
+            self.id = 0
+        t = now - self.t0
+        block = log_block_data_control_loop_t(
+            log_type_t.LOG_TYPE_PID,
+            int((now - self.t0_clock) * (1 + self.skew) * 1000) + self.clock_offset_ms,
+            self.id,
+            roll_error=math.sin(t + self.node_id),
+            pitch_error=math.cos(t + self.node_id),
+            battery=12.6 - t / 600,
+        )
+        self.id += 1
+        return block.to_bytes()
+
+    def serve(self) -> None:
+        server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        server.bind(('127.0.0.1', self.port))
+        server.listen(1)
+        print(f'Node mock {self.node_id} listening on 127.0.0.1:{self.port}, {self.rate} blocks/s')
+
+        while True:
+            client, addr = server.accept()
+            print(f'Client connected: {addr}')
+            try:
+                self._stream(client)
+            except OSError as e:
+                print(f'Client disconnected: {e}')
+            client.close()
+
+    def _stream(self, client: socket.socket) -> None:
+        # Send in 10 ms batches, like the node draining its ring
+        batch_period = 0.01
+        next_batch = time.monotonic()
+        # (send time, batch), batches made during a stall go out when it ends
+        pending = deque()
+        while True:
+            n = max(1, int(self.rate * batch_period))
+            now = time.monotonic()
+            t_stall = (now - self.t0) % 1
+            send_at = (now - t_stall + self.stall_ms / 1000) if (t_stall < self.stall_ms / 1000) else now
+            pending.append((send_at, b''.join(self.gen_block() for _ in range(n))))
+            while pending and (pending[0][0] <= now):
+                client.sendall(pending.popleft()[1])
+            next_batch += n / self.rate
+            time.sleep(max(0, next_batch - time.monotonic()))
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Stand-in telemetry node')
+    parser.add_argument('port', type=int, nargs='?', default=8080)
+    parser.add_argument('rate', type=float, nargs='?', default=1000, help='blocks per second')
+    parser.add_argument('node_id', type=int, nargs='?', default=0)
+    parser.add_argument('--skew', type=float, default=0)
+    parser.add_argument('--clock-offset', type=int, default=0, help='ms')
+    parser.add_argument('--stall', type=float, default=0, help='ms')
+    parser.add_argument('--reset-after', type=float, default=None, help='s')
+    args = parser.parse_args()
+
+    NodeMock(args.port, args.rate, args.node_id, args.skew, args.clock_offset,
+             args.stall, args.reset_after).serve()
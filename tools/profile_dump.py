@@ -0,0 +1,159 @@
+'''
+Asks a telemetry node built with VSTP_PROFILE for its main loop profile
+and prints it, per phase of VstpNode::update():
+ - calls, total time and share of the profiled time
+ - mean and max time per call
+ - a log2 histogram of the time per call
+
+The profile is queued behind the logged blocks in the RX ring, so the node
+must be streaming, i.e. the FC must have sent VSTP_CMD_LOG_START.
+
+The node serves one client. While telemetry_server streams from it, ask the
+server instead: it forwards the dump over its connection to the node, and the
+profile comes back as profile_phase records in /api/stream.
+
+Usage: python3 profile_dump.py <ip> [port] [--reset]
+       python3 profile_dump.py --server <server ip>[:http port] [--node <id>] [--reset]
+  --reset  also clears the profile, so the next dump starts over
+'''
+import json
+import socket
+import struct
+import sys
+import time
+import urllib.error
+import urllib.request
+from pathlib import Path
+
+sys.path.append(str(Path(__file__).absolute().parent.joinpath('client')))
+
+from client.log_types import (LOG_BLOCK_FILTERED, LOG_BLOCK_TYPES, filtered_fmt, log_block_data_profile_phase_t,
+                              log_block_header_t, log_profile_phase_t, log_type_t)
+
+
+# Must match vstp_cmd_t in include/vstp.h
+VSTP_CMD_PROFILE_DUMP = 7
+VSTP_CMD_PROFILE_RESET = 8
+
+# Must match include/vstp_profile.h
+HIST_SHIFT = 4
+
+DUMP_TIMEOUT_S = 5
+
+
+def vstp_packet(cmd: int) -> bytes:
+    # No payload, so the CRC is cmd ^ len
+    return bytes([cmd, 0, cmd])
+
+
+def recv_exact(sock: socket.socket, size: int) -> bytes:
+    data = b''
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            raise ConnectionError('Node closed the connection')
+        data += chunk
+    return data
+
+
+def read_profile(sock: socket.socket) -> list:
+    ''' Skips the logged blocks until a whole profile has been received. '''
+    phases = {}
+    t_end = time.time() + DUMP_TIMEOUT_S
+    while (len(phases) < len(log_profile_phase_t)) and (time.time() < t_end):
+        header_args = struct.unpack(log_block_header_t.fmt, recv_exact(sock, log_block_header_t.size))
+        header = log_block_header_t(*header_args)
+        block_type = LOG_BLOCK_TYPES.get(header.type)
+        if block_type is None:
+            raise ValueError(f'Unknown log type {header.type}, stream is out of sync')
+        data = recv_exact(sock, block_type.size)
+        if header.type in LOG_BLOCK_FILTERED:
+            field_mask = struct.unpack(block_type.fmt, data)[0]
+            recv_exact(sock, struct.calcsize(filtered_fmt(LOG_BLOCK_FILTERED[header.type], field_mask)))
+        if header.type == log_type_t.LOG_TYPE_PROFILE:
+            block = log_block_data_profile_phase_t(*(header_args + struct.unpack(block_type.fmt, data)))
+            phases[block.phase] = block
+    return [phases[p] for p in sorted(phases)]
+
+
+def read_profile_from_server(server: str, node: int, reset: bool) -> list:
+    ''' Asks telemetry_server for a dump and reads the profile from its stream. '''
+    phases = {}
+    with urllib.request.urlopen(f'http://{server}/api/stream?hz=0', timeout=DUMP_TIMEOUT_S) as stream:
+        # Streaming before the dump is sent, so no profile_phase record is missed
+        urllib.request.urlopen(f'http://{server}/api/command?cmd=profile_dump&node={node}').read()
+        t_end = time.time() + DUMP_TIMEOUT_S
+        for line in stream:
+            if line.startswith(b'data: '):
+                record = json.loads(line[6:])
+                if (record['node'] == node) and (record['type'] == 'profile_phase'):
+                    block = log_block_data_profile_phase_t(log_type_t.LOG_TYPE_PROFILE, record['timestamp'],
+                                                           record['id'], **record['data'])
+                    phases[block.phase] = block
+            if (len(phases) == len(log_profile_phase_t)) or (time.time() > t_end):
+                break
+    if reset:
+        urllib.request.urlopen(f'http://{server}/api/command?cmd=profile_reset&node={node}').read()
+    return [phases[p] for p in sorted(phases)]
+
+
+def print_profile(phases: list) -> None:
+    first = phases[0]
+    us = lambda cycles: cycles / first.cycles_per_us
+    # BUSY, IDLE and OUTSIDE together cover all the time
+    loop_cycles = sum(p.total_cycles for p in phases if p.phase in (log_profile_phase_t.LOG_PROFILE_PHASE_BUSY,
+                                                                   log_profile_phase_t.LOG_PROFILE_PHASE_IDLE,
+                                                                   log_profile_phase_t.LOG_PROFILE_PHASE_OUTSIDE))
+
+    print(f'Profile over {first.elapsed_ms / 1000:.1f} s, {first.cycles_per_us} cycles/us, '
+          f'server listen restarts: {first.listen_restarts}')
+    print(f'{"phase":<12} {"calls":>10} {"total ms":>10} {"share":>7} {"mean us":>9} {"max us":>9}  histogram (us)')
+    for p in phases:
+        name = log_profile_phase_t(p.phase).name.replace('LOG_PROFILE_PHASE_', '')
+        share = 100 * p.total_cycles / loop_cycles if loop_cycles else 0
+        mean = us(p.total_cycles / p.calls) if p.calls else 0
+        hist = [getattr(p, f'hist_{i}') for i in range(16)]
+        # The last bin is open ended
+        bins = ' '.join((f'<{us(2 ** (i + HIST_SHIFT + 1)):g}' if i < 15 else f'>={us(2 ** (i + HIST_SHIFT)):g}') + f':{n}'
+                        for i, n in enumerate(hist) if n)
+        print(f'{name:<12} {p.calls:>10} {us(p.total_cycles) / 1000:>10.1f} {share:>6.1f}% '
+              f'{mean:>9.2f} {us(p.max_cycles):>9.1f}  {bins}')
+
+
+if __name__ == '__main__':
+    argv = sys.argv[1:]
+    server = argv[argv.index('--server') + 1] if '--server' in argv else None
+    node = int(argv[argv.index('--node') + 1]) if '--node' in argv else 0
+    args = [a for i, a in enumerate(argv) if not a.startswith('--') and not (i > 0 and argv[i - 1] in ('--server', '--node'))]
+    reset = '--reset' in argv
+    if (server is None) and not args:
+        print(__doc__)
+        sys.exit(1)
+
+    if server is not None:
+        if ':' not in server:
+            server += ':9090'
+        try:
+            phases = read_profile_from_server(server, node, reset)
+        except urllib.error.HTTPError as e:
+            print(f'Dump failed: {e.read().decode().strip()}')
+            sys.exit(1)
+        except socket.timeout:
+            phases = []
+    else:
+        ip = args[0]
+        port = int(args[1]) if len(args) > 1 else 80
+
+        with socket.create_connection((ip, port), timeout=DUMP_TIMEOUT_S) as sock:
+            sock.sendall(vstp_packet(VSTP_CMD_PROFILE_DUMP))
+            try:
+                phases = read_profile(sock)
+            except socket.timeout:
+                phases = []
+            if reset:
+                sock.sendall(vstp_packet(VSTP_CMD_PROFILE_RESET))
+
+    if not phases:
+        print('No profile received, is the node built with -D VSTP_PROFILE?')
+        sys.exit(1)
+    print_profile(phases)
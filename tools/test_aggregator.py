@@ -0,0 +1,219 @@
+'''
+Runs telemetry_server against several localhost stand-in nodes
+(node_mock.py) and checks the merged stream:
+ - records from every node are present and tagged with their node id
+ - merged time never decreases
+ - no records are lost per node while all nodes are up
+ - the merge keeps going when one node goes away
+ - a node whose link stalls for less than the reorder window loses nothing,
+   one that stalls for longer has the oldest records dropped and counted as late
+ - FC clocks that run fast or slow stay on the host clock, without drops
+ - a node whose FC reboots (timestamps and ids restart) keeps streaming
+
+Build the server first with `make -C tools/client`.
+'''
+import json
+import subprocess
+import sys
+import time
+import urllib.request
+from pathlib import Path
+
+TOOLS = Path(__file__).absolute().parent
+SERVER = str(TOOLS.joinpath('client', 'telemetry_server'))
+NODE_MOCK = str(TOOLS.joinpath('node_mock.py'))
+
+HTTP_PORT = 9390
+NODE_PORT = 9391
+WINDOW_MS = 200
+
+
+def read_stream(seconds: float) -> list:
+    records = []
+    t_end = time.time() + seconds
+    with urllib.request.urlopen(f'http://127.0.0.1:{HTTP_PORT}/api/stream?hz=0') as stream:
+        for line in stream:
+            if line.startswith(b'data: '):
+                records.append(json.loads(line[6:]))
+            if time.time() > t_end:
+                break
+    return records
+
+
+def node_stats() -> list:
+    with urllib.request.urlopen(f'http://127.0.0.1:{HTTP_PORT}/api/stats') as stats:
+        return json.load(stats)['nodes']
+
+
+def start(nodes: list) -> list:
+    ''' Starts a node_mock per (blocks/s, options) and the server, returns the processes. '''
+    procs = [subprocess.Popen([sys.executable, NODE_MOCK, str(NODE_PORT + i), str(rate), str(i)] + options,
+                              stdout=subprocess.DEVNULL)
+             for i, (rate, options) in enumerate(nodes)]
+    time.sleep(0.5)
+    procs.append(subprocess.Popen([SERVER, '-l', str(HTTP_PORT), '-w', str(WINDOW_MS)] +
+                                  [f'127.0.0.1:{NODE_PORT + i}' for i in range(len(nodes))],
+                                  stdout=subprocess.DEVNULL))
+    time.sleep(1.5)
+    return procs
+
+
+def check_order(records: list) -> bool:
+    times = [r['time'] for r in records]
+    if any(b < a for a, b in zip(times, times[1:])):
+        print('FAIL: merged time decreases')
+        return False
+    return True
+
+
+def check(records: list, node_ids: list) -> bool:
+    ok = check_order(records)
+    for node in node_ids:
+        ids = [r['id'] for r in records if r['node'] == node]
+        if not ids:
+            print(f'FAIL: no records from node {node}')
+            ok = False
+        elif ids != list(range(ids[0], ids[0] + len(ids))):
+            print(f'FAIL: records missing from node {node}')
+            ok = False
+        else:
+            print(f'node {node}: {len(ids)} records in order')
+    return ok
+
+
+def check_late(before: list, after: list, expected: dict) -> bool:
+    ''' expected: node -> whether it should have late records between the stats. '''
+    ok = True
+    for node, late in expected.items():
+        n = after[node]['late'] - before[node]['late']
+        print(f'node {node}: {n} late')
+        if late and (n == 0):
+            print(f'FAIL: node {node} should have late records')
+            ok = False
+        if not late and (n > 0):
+            print(f'FAIL: node {node} should have no late records')
+            ok = False
+    return ok
+
+
+def test_in_order() -> bool:
+    print('-- In order --')
+    procs = start([(1000, []), (500, []), (200, [])])
+    try:
+        print('All nodes up')
+        ok = check(read_stream(5), [0, 1, 2])
+
+        print('Node 2 stopped')
+        procs[2].kill()
+        time.sleep(0.5)
+        ok &= check(read_stream(3), [0, 1])
+        for node in node_stats():
+            print(node)
+    finally:
+        for proc in procs:
+            proc.kill()
+    return ok
+
+
+def test_reorder_window() -> bool:
+    print('-- Link stalls within the reorder window --')
+    procs = start([(500, []), (500, ['--stall', str(WINDOW_MS * 0.6)])])
+    try:
+        before = node_stats()
+        ok = check(read_stream(5), [0, 1])
+        ok &= check_late(before, node_stats(), {0: False, 1: False})
+    finally:
+        for proc in procs:
+            proc.kill()
+    return ok
+
+
+def test_late_drops() -> bool:
+    print('-- Link stalls beyond the reorder window --')
+    procs = start([(500, []), (500, ['--stall', str(WINDOW_MS * 3)])])
+    try:
+        before = node_stats()
+        records = read_stream(5)
+        after = node_stats()
+        ok = check_order(records) & check(records, [0])
+        ok &= check_late(before, after, {0: False, 1: True})
+
+        # Every record of the late node is either in the stream or counted
+        ids = [r['id'] for r in records if r['node'] == 1]
+        missing = (ids[-1] - ids[0] + 1) - len(ids)
+        late = after[1]['late'] - before[1]['late']
+        print(f'node 1: {len(ids)} records, {missing} missing, {late} late')
+        if (missing == 0) or (missing > late):
+            print('FAIL: records of node 1 went missing without being counted as late')
+            ok = False
+    finally:
+        for proc in procs:
+            proc.kill()
+    return ok
+
+
+def test_skew() -> bool:
+    print('-- Skewed FC clocks --')
+    procs = start([(500, []),
+                   (500, ['--skew', '0.03', '--clock-offset', '1000000']),
+                   (500, ['--skew', '-0.03', '--clock-offset', '5000'])])
+    try:
+        before = node_stats()
+        records = read_stream(8)
+        after = node_stats()
+        ok = check(records, [0, 1, 2])
+        ok &= check_late(before, after, {0: False, 1: False, 2: False})
+
+        # The offset follows the skew, so every node stays close to the host clock
+        for node in after:
+            print(f'node {node["node"]}: lag {node["lag_ms"]} ms')
+            if not (0 <= node['lag_ms'] < WINDOW_MS / 2):
+                print(f'FAIL: node {node["node"]} drifted off the host clock')
+                ok = False
+    finally:
+        for proc in procs:
+            proc.kill()
+    return ok
+
+
+def test_clock_reset() -> bool:
+    print('-- FC reboot --')
+    procs = start([(500, []), (500, ['--clock-offset', '100000', '--reset-after', '4'])])
+    try:
+        before = node_stats()
+        records = read_stream(5)
+        after = node_stats()
+        ok = check_order(records) & check(records, [0])
+
+        # Ids of node 1 restart at 0 with the reboot, in order on both sides
+        ids = [r['id'] for r in records if r['node'] == 1]
+        reset = next((i for i in range(1, len(ids)) if ids[i] < ids[i - 1]), None)
+        if reset is None:
+            print('FAIL: node 1 did not reboot while streaming')
+            ok = False
+        else:
+            old, new = ids[:reset], ids[reset:]
+            print(f'node 1: {len(old)} records before the reboot, {len(new)} after')
+            if (old != list(range(old[0], old[0] + len(old)))) or (new != list(range(new[0], new[0] + len(new)))):
+                print('FAIL: records of node 1 missing around the reboot')
+                ok = False
+            if new[0] > 0:
+                print(f'FAIL: the first {new[0]} records after the reboot were dropped')
+                ok = False
+        ok &= check_late(before, after, {0: False, 1: False})
+    finally:
+        for proc in procs:
+            proc.kill()
+    return ok
+
+
+if __name__ == '__main__':
+    ok = True
+    ok &= test_in_order()
+    ok &= test_reorder_window()
+    ok &= test_late_drops()
+    ok &= test_skew()
+    ok &= test_clock_reset()
+
+    print('OK' if ok else 'FAILED')
+    sys.exit(0 if ok else 1)
@@ -0,0 +1,118 @@
+'''
+Checks that host_node keeps serving after the end of its FC stream:
+ - once stdin is closed (EOF), the node sleeps between ticks instead of
+   spinning on the hung up fd
+ - the client still gets every block the FC sent before the EOF
+ - the node keeps running and accepts the next client
+
+Build first with `make -C tools/host_node`.
+'''
+import os
+import socket
+import struct
+import subprocess
+import sys
+import time
+from pathlib import Path
+
+TOOLS = Path(__file__).absolute().parent
+HOST_NODE = str(TOOLS.joinpath('host_node', 'host_node'))
+
+sys.path.append(str(TOOLS.joinpath('client')))
+
+from client.log_types import LOG_BLOCK_TYPES, log_block_data_control_loop_t, log_block_header_t, log_type_t
+
+NODE_PORT = 9380
+# Fit in the node's ring below the summary mode threshold
+BLOCKS = 50
+# Of one core, after the EOF. Spinning on POLLHUP takes all of it.
+MAX_CPU = 0.1
+
+# Must match vstp_cmd_t in include/vstp.h
+VSTP_CMD_LOG_START = 1
+VSTP_CMD_LOG_DATA = 3
+
+
+def vstp_packet(cmd: int, payload: bytes = b'') -> bytes:
+    crc = cmd ^ len(payload)
+    for byte in payload:
+        crc ^= byte
+    return bytes([cmd, len(payload), crc]) + payload
+
+
+def cpu_seconds(pid: int) -> float:
+    ''' User + system time of a process, from /proc. '''
+    with open(f'/proc/{pid}/stat') as f:
+        fields = f.read().rsplit(')', 1)[1].split()
+    return (int(fields[11]) + int(fields[12])) / os.sysconf('SC_CLK_TCK')
+
+
+def read_blocks(sock: socket.socket, seconds: float) -> list:
+    ''' Decodes the control loop blocks the node streams within the time. '''
+    blocks = []
+    buf = b''
+    sock.settimeout(0.1)
+    t_end = time.monotonic() + seconds
+    while time.monotonic() < t_end:
+        try:
+            buf += sock.recv(65536)
+        except socket.timeout:
+            continue
+        while len(buf) >= log_block_header_t.size:
+            header = log_block_header_t(*struct.unpack(log_block_header_t.fmt, buf[:log_block_header_t.size]))
+            block_type = LOG_BLOCK_TYPES[header.type]
+            size = log_block_header_t.size + block_type.size
+            if len(buf) < size:
+                break
+            if header.type == log_type_t.LOG_TYPE_PID:
+                blocks.append(block_type(*struct.unpack(log_block_header_t.fmt + block_type.fmt[1:], buf[:size])))
+            buf = buf[size:]
+    return blocks
+
+
+if __name__ == '__main__':
+    ok = True
+
+    node = subprocess.Popen([HOST_NODE, '-p', str(NODE_PORT)], stdin=subprocess.PIPE)
+    time.sleep(0.3)
+    try:
+        client = socket.create_connection(('127.0.0.1', NODE_PORT))
+        time.sleep(0.1)
+
+        # A short FC stream, then EOF
+        stream = vstp_packet(VSTP_CMD_LOG_START)
+        for i in range(BLOCKS):
+            block = log_block_data_control_loop_t(log_type_t.LOG_TYPE_PID, i, i)
+            stream += vstp_packet(VSTP_CMD_LOG_DATA, block.to_bytes())
+        node.stdin.write(stream)
+        node.stdin.close()
+
+        ids = [b.id for b in read_blocks(client, 1)]
+        print(f'Received {len(ids)} blocks')
+        if ids != list(range(BLOCKS)):
+            print(f'FAIL: expected the {BLOCKS} blocks sent before the EOF')
+            ok = False
+
+        cpu = cpu_seconds(node.pid)
+        time.sleep(2)
+        load = (cpu_seconds(node.pid) - cpu) / 2
+        print(f'CPU after the EOF: {100 * load:.0f}%')
+        if load > MAX_CPU:
+            print('FAIL: the node spins on the closed UART')
+            ok = False
+
+        client.close()
+        time.sleep(0.1)
+        try:
+            socket.create_connection(('127.0.0.1', NODE_PORT), timeout=1).close()
+        except OSError as e:
+            print(f'FAIL: the node no longer accepts clients: {e}')
+            ok = False
+        if node.poll() is not None:
+            print(f'FAIL: the node exited with {node.returncode}')
+            ok = False
+    finally:
+        node.kill()
+
+    print('OK' if ok else 'FAILED')
+    sys.exit(0 if ok else 1)
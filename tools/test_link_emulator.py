@@ -0,0 +1,171 @@
+'''
+Runs host_node behind the link emulator and checks that the timeline is
+imposed on the stream:
+ - a bandwidth cap limits the throughput and fills the node's RX ring,
+   until the node switches to summary mode
+ - loss over TCP shows up as retransmits
+ - nothing arrives while the link is down, not even what was on its way
+ - a disconnect drops the connection, and the client gets back in
+Then prints the report of tools/link_report.py.
+
+Build first with `make -C tools/client` and `make -C tools/host_node`.
+'''
+import re
+import socket
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+from pathlib import Path
+
+TOOLS = Path(__file__).absolute().parent
+HOST_NODE = str(TOOLS.joinpath('host_node', 'host_node'))
+LINK_PROXY = str(TOOLS.joinpath('client', 'link_proxy'))
+LINK_REPORT = str(TOOLS.joinpath('link_report.py'))
+
+sys.path.append(str(TOOLS.joinpath('client')))
+
+from client.log_types import log_block_data_control_loop_t, log_type_t
+from link_report import read_arrivals, read_stats
+
+NODE_PORT = 9397
+PROXY_PORT = 9398
+RATE = 1000
+DURATION_S = 17
+CAP_KBPS = 400
+
+# Must match vstp_cmd_t in include/vstp.h
+VSTP_CMD_LOG_START = 1
+VSTP_CMD_LOG_DATA = 3
+
+TIMELINE = f'''
+# t_s  settings
+0      latency=2 jitter=1
+2      loss=5 burst=3
+5      loss=0 bw={CAP_KBPS}
+9      bw=0 latency=300
+10     down
+12     up latency=2
+14     disconnect
+'''
+
+
+def vstp_packet(cmd: int, payload: bytes = b'') -> bytes:
+    crc = cmd ^ len(payload)
+    for byte in payload:
+        crc ^= byte
+    return bytes([cmd, len(payload), crc]) + payload
+
+
+def feed_fc(uart, stop: threading.Event) -> None:
+    ''' Streams control loop blocks into the node's UART, like the FC. '''
+    uart.write(vstp_packet(VSTP_CMD_LOG_START))
+    t0 = time.monotonic()
+    i = 0
+    while not stop.is_set():
+        batch = b''
+        while i < (time.monotonic() - t0) * RATE:
+            block = log_block_data_control_loop_t(log_type_t.LOG_TYPE_PID, i, i, roll_error=i % 100)
+            batch += vstp_packet(VSTP_CMD_LOG_DATA, block.to_bytes())
+            i += 1
+        uart.write(batch)
+        uart.flush()
+        time.sleep(0.01)
+
+
+def read_client(stop: threading.Event) -> None:
+    ''' Reads everything it gets, and reconnects like a dashboard. '''
+    while not stop.is_set():
+        try:
+            with socket.create_connection(('127.0.0.1', PROXY_PORT), timeout=0.5) as sock:
+                while not stop.is_set():
+                    try:
+                        if not sock.recv(65536):
+                            break
+                    except socket.timeout:
+                        pass
+        except OSError:
+            pass
+        time.sleep(0.2)
+
+
+if __name__ == '__main__':
+    ok = True
+
+    with tempfile.TemporaryDirectory() as tmp:
+        timeline = Path(tmp).joinpath('timeline.txt')
+        timeline.write_text(TIMELINE)
+        arrivals_path = str(Path(tmp).joinpath('arrivals.csv'))
+        stats_path = str(Path(tmp).joinpath('node_stats.csv'))
+
+        node = subprocess.Popen([HOST_NODE, '-p', str(NODE_PORT), '-s', stats_path], stdin=subprocess.PIPE)
+        time.sleep(0.5)
+        proxy = subprocess.Popen([LINK_PROXY, '-t', str(timeline), '-o', arrivals_path, '-d', str(DURATION_S),
+                                  str(PROXY_PORT), f'127.0.0.1:{NODE_PORT}'], stdout=subprocess.PIPE, text=True)
+        time.sleep(0.2)
+
+        stop = threading.Event()
+        threads = [threading.Thread(target=feed_fc, args=(node.stdin, stop), daemon=True),
+                   threading.Thread(target=read_client, args=(stop,), daemon=True)]
+        for t in threads:
+            t.start()
+
+        out, _ = proxy.communicate(timeout=DURATION_S + 10)
+        stop.set()
+        node.kill()
+        print(out)
+
+        arrivals = read_arrivals(arrivals_path)
+        stats = read_stats(stats_path)
+        from_node = [p for p in arrivals if p['from'] == 'node']
+        seg_start = {p['segment']: p['read_us'] for p in arrivals if p['from'] == 'link'}
+
+        # Loss: segment 1
+        retransmits = sum(p['retransmits'] for p in from_node if p['segment'] == 1)
+        print(f'Retransmits: {retransmits}')
+        if retransmits == 0:
+            print('FAIL: no retransmits over a lossy link')
+            ok = False
+
+        # Bandwidth cap: segment 2
+        # Skips the first second, while the backlog of the lossy link drains
+        t_first = seg_start[2] + 1000000
+        t_last = seg_start[3]
+        capped = [p for p in from_node if not p['lost'] and (t_first <= p['arrival_us'] < t_last)]
+        kbps = sum(p['bytes'] for p in capped) * 8 / 1000 / ((t_last - t_first) / 1e6)
+        ring_max = max(100 * s['ring_used'] / s['ring_size'] for s in stats if t_first <= s['time_us'] <= t_last)
+        modes = {s['link_mode'] for s in stats if t_first <= s['time_us'] <= t_last}
+        print(f'Capped: {kbps:.0f} kbit/s, ring max {ring_max:.0f}%, link modes {modes}')
+        if kbps > CAP_KBPS * 1.1:
+            print(f'FAIL: {kbps:.0f} kbit/s over the {CAP_KBPS} kbit/s cap')
+            ok = False
+        if 1 not in modes:
+            print('FAIL: the capped link did not congest the node')
+            ok = False
+
+        # Outage: segment 4, a 2 s gap in the arrivals
+        times = sorted(p['arrival_us'] for p in from_node if (p['segment'] in (3, 4)) and not p['lost'])
+        gap = max(b - a for a, b in zip(times, times[1:])) / 1e6
+        print(f'Longest gap: {gap:.1f} s')
+        if not (1.8 <= gap <= 2.5):
+            print('FAIL: expected a 2 s outage')
+            ok = False
+        # Not even what was on its way before it
+        during = [p for p in from_node if not p['lost'] and (seg_start[4] < p['arrival_us'] < seg_start[5])]
+        if during:
+            print(f'FAIL: {len(during)} packets arrived while the link was down')
+            ok = False
+
+        # Disconnect: segment 6, the client is back
+        connections = int(re.search(r'Connections: (\d+)', out).group(1))
+        after = [p for p in from_node if p['segment'] == 6]
+        print(f'Connections: {connections}, packets after the disconnect: {len(after)}')
+        if (connections < 2) or not after:
+            print('FAIL: the client did not get back after the disconnect')
+            ok = False
+
+        subprocess.run([sys.executable, LINK_REPORT, arrivals_path, '--stats', stats_path])
+
+    print('OK' if ok else 'FAILED')
+    sys.exit(0 if ok else 1)
@@ -0,0 +1,226 @@
+'''
+Drives the RX ring of host_node over and under the link mode thresholds, by
+pausing and resuming the client that reads it:
+ - the node switches to summary mode once the ring is 75% full
+ - it switches back after the ring has stayed below 25% for the 1 s hold
+ - congesting again within 10 s of recovering doubles the hold to 2 s
+ - the control_loop_summary blocks of every window the ring had room for
+   decode to the min, max, mean and last of the FC blocks in the window
+
+Build first with `make -C tools/host_node`.
+'''
+import csv
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+from pathlib import Path
+
+TOOLS = Path(__file__).absolute().parent
+HOST_NODE = str(TOOLS.joinpath('host_node', 'host_node'))
+
+sys.path.append(str(TOOLS.joinpath('client')))
+
+from client.log_types import (LOG_BLOCK_FILTERED, LOG_BLOCK_TYPES, log_block_data_control_loop_t,
+                              log_block_header_t, log_link_mode_t, log_summary_stat_t, log_type_t)
+
+NODE_PORT = 9370
+RATE = 1000
+
+# Must match include/vstp.h
+VSTP_CMD_LOG_START = 1
+VSTP_CMD_LOG_DATA = 3
+VSTP_LINK_CONGESTED_PCT = 75
+VSTP_LINK_RECOVERED_PCT = 25
+VSTP_LINK_RECOVER_HOLD_MS = 1000
+
+# (t_s, reading): the client pauses to congest the node and resumes to let
+# it recover, the second time within VSTP_LINK_STABLE_MS of the recovery
+SCHEDULE = [(1, False), (3, True), (5.5, False), (7, True), (10.5, None)]
+
+
+def vstp_packet(cmd: int, payload: bytes = b'') -> bytes:
+    crc = cmd ^ len(payload)
+    for byte in payload:
+        crc ^= byte
+    return bytes([cmd, len(payload), crc]) + payload
+
+
+def fc_block(i: int) -> log_block_data_control_loop_t:
+    return log_block_data_control_loop_t(log_type_t.LOG_TYPE_PID, i, i, roll_error=float(i % 100),
+                                         rc_in_roll=i % 1000, is_armed=(i % 3 == 0))
+
+
+def feed_fc(uart, stop: threading.Event) -> None:
+    ''' Streams control loop blocks into the node's UART, like the FC. '''
+    uart.write(vstp_packet(VSTP_CMD_LOG_START))
+    t0 = time.monotonic()
+    i = 0
+    while not stop.is_set():
+        batch = b''
+        while i < (time.monotonic() - t0) * RATE:
+            batch += vstp_packet(VSTP_CMD_LOG_DATA, fc_block(i).to_bytes())
+            i += 1
+        uart.write(batch)
+        uart.flush()
+        time.sleep(0.01)
+
+
+def read_client(blocks: list, reading: threading.Event, stop: threading.Event) -> None:
+    ''' Decodes the node stream into blocks, but only reads while reading is set. '''
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    # Small buffers, so pausing backs up into the node's ring quickly
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4096)
+    sock.connect(('127.0.0.1', NODE_PORT))
+    sock.settimeout(0.05)
+    buf = b''
+    while not stop.is_set():
+        if not reading.is_set():
+            time.sleep(0.01)
+            continue
+        try:
+            buf += sock.recv(65536)
+        except socket.timeout:
+            continue
+        while len(buf) >= log_block_header_t.size:
+            header = log_block_header_t(*struct.unpack(log_block_header_t.fmt, buf[:log_block_header_t.size]))
+            block_type = LOG_BLOCK_TYPES[header.type]
+            assert header.type not in LOG_BLOCK_FILTERED
+            size = log_block_header_t.size + block_type.size
+            if len(buf) < size:
+                break
+            blocks.append(block_type(*struct.unpack(log_block_header_t.fmt + block_type.fmt[1:], buf[:size])))
+            buf = buf[size:]
+    sock.close()
+
+
+def f32(value: float) -> float:
+    return struct.unpack('<f', struct.pack('<f', value))[0]
+
+
+def check_summaries(summaries: list) -> bool:
+    ''' Checks every window against the FC blocks it was made from. '''
+    windows = {}
+    for s in summaries:
+        windows.setdefault((s.window_start, s.timestamp), {})[s.stat] = s
+
+    ok = True
+    complete = 0
+    for (start, end), stats in windows.items():
+        fc = [fc_block(i) for i in range(start, end + 1)]
+        n = len(fc)
+        if any(s.samples != n for s in stats.values()):
+            print(f'FAIL: window [{start}, {end}] has samples {[s.samples for s in stats.values()]}, expected {n}')
+            ok = False
+            continue
+        # While the client pauses, the ring fills up and discards blocks
+        if len(stats) != len(log_summary_stat_t):
+            continue
+        complete += 1
+
+        roll = [b.roll_error for b in fc]
+        rc = [b.rc_in_roll for b in fc]
+        armed = [b.is_armed for b in fc]
+        expected = {
+            log_summary_stat_t.LOG_SUMMARY_MIN: (min(roll), min(rc), min(armed)),
+            log_summary_stat_t.LOG_SUMMARY_MAX: (max(roll), max(rc), max(armed)),
+            # Integer means are rounded, booleans are true from 0.5
+            log_summary_stat_t.LOG_SUMMARY_MEAN: (f32(sum(roll) / n), int(sum(rc) / n + 0.5), sum(armed) / n >= 0.5),
+            log_summary_stat_t.LOG_SUMMARY_LAST: (roll[-1], rc[-1], armed[-1]),
+        }
+        for stat, (roll_value, rc_value, armed_value) in expected.items():
+            s = stats[stat]
+            if (abs(s.roll_error - roll_value) > 1e-4 * max(1, abs(roll_value))) or \
+               (abs(s.rc_in_roll - rc_value) > (1 if stat == log_summary_stat_t.LOG_SUMMARY_MEAN else 0)) or \
+               (bool(s.is_armed) != armed_value):
+                print(f'FAIL: window [{start}, {end}] {log_summary_stat_t(stat).name}: '
+                      f'{s.roll_error}, {s.rc_in_roll}, {s.is_armed}, expected {roll_value}, {rc_value}, {armed_value}')
+                ok = False
+
+    print(f'Summaries: {len(windows)} windows, {complete} complete')
+    if complete < 10:
+        print('FAIL: too few complete summary windows')
+        ok = False
+    return ok
+
+
+def recover_holds(stats: list) -> list:
+    ''' Returns, per switch back to full rate, how long the ring had been below the threshold. '''
+    holds = []
+    t_high = None
+    for prev, s in zip(stats, stats[1:]):
+        if 100 * s['ring_used'] // s['ring_size'] > VSTP_LINK_RECOVERED_PCT:
+            t_high = s['time_us']
+        if (prev['link_mode'] == log_link_mode_t.LOG_LINK_MODE_SUMMARY) and \
+           (s['link_mode'] == log_link_mode_t.LOG_LINK_MODE_FULL_RATE):
+            holds.append((s['time_us'] - t_high) / 1e6)
+    return holds
+
+
+if __name__ == '__main__':
+    ok = True
+
+    with tempfile.TemporaryDirectory() as tmp:
+        stats_path = str(Path(tmp).joinpath('node_stats.csv'))
+        node = subprocess.Popen([HOST_NODE, '-p', str(NODE_PORT), '-s', stats_path],
+                                stdin=subprocess.PIPE, stderr=subprocess.DEVNULL)
+        time.sleep(0.3)
+
+        blocks = []
+        reading = threading.Event()
+        reading.set()
+        stop = threading.Event()
+        threads = [threading.Thread(target=feed_fc, args=(node.stdin, stop), daemon=True),
+                   threading.Thread(target=read_client, args=(blocks, reading, stop), daemon=True)]
+        for t in threads:
+            t.start()
+
+        t0 = time.monotonic()
+        for t_s, read in SCHEDULE:
+            time.sleep(max(0, t0 + t_s - time.monotonic()))
+            if read is None:
+                break
+            print(f'{t_s:4.1f} s: client {"reads" if read else "pauses"}')
+            if read:
+                reading.set()
+            else:
+                reading.clear()
+
+        stop.set()
+        for t in threads:
+            t.join()
+        node.kill()
+
+        with open(stats_path) as f:
+            stats = [{k: int(v) for k, v in row.items()} for row in csv.DictReader(f)]
+
+    # Entry: the link_mode markers hold the ring occupancy at the switch
+    markers = [b for b in blocks if b.type == log_type_t.LOG_TYPE_LINK_MODE]
+    modes = [log_link_mode_t(m.mode).name.replace('LOG_LINK_MODE_', '') for m in markers]
+    print(f'Link modes: {modes}')
+    if [m.mode for m in markers] != [log_link_mode_t.LOG_LINK_MODE_SUMMARY, log_link_mode_t.LOG_LINK_MODE_FULL_RATE] * 2:
+        print('FAIL: expected two congestions, each followed by a recovery')
+        ok = False
+    for m in markers:
+        used_pct = 100 * m.ring_used / m.ring_size
+        if m.mode == log_link_mode_t.LOG_LINK_MODE_SUMMARY:
+            print(f'Congested at {used_pct:.0f}%')
+            if used_pct < VSTP_LINK_CONGESTED_PCT:
+                print(f'FAIL: switched to summary below {VSTP_LINK_CONGESTED_PCT}%')
+                ok = False
+
+    # Recovery: the hold, then the doubled hold
+    holds = recover_holds(stats)
+    print(f'Recovery holds: {", ".join(f"{h:.2f} s" for h in holds)}')
+    expected = [VSTP_LINK_RECOVER_HOLD_MS / 1000, 2 * VSTP_LINK_RECOVER_HOLD_MS / 1000]
+    if (len(holds) != len(expected)) or any(abs(h - e) > 0.1 for h, e in zip(holds, expected)):
+        print(f'FAIL: expected holds of {expected} s')
+        ok = False
+
+    ok &= check_summaries([b for b in blocks if b.type == log_type_t.LOG_TYPE_PID_SUMMARY])
+
+    print('OK' if ok else 'FAILED')
+    sys.exit(0 if ok else 1)
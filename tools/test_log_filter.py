@@ -0,0 +1,181 @@
+'''
+Checks the control_loop field filter of the node (VSTP_CMD_LOG_FILTER):
+ - host_node sends control_loop_filtered blocks with only the fields of
+   the mask, and full control_loop blocks again after an empty filter
+ - the Python decoder of tools/client/log_types.py reads them back
+ - telemetry_server streams them as control_loop records with only the
+   filtered fields, and /api/range has the filtered fields and null for
+   the others
+
+Build first with `make -C tools/client` and `make -C tools/host_node`.
+'''
+import json
+import socket
+import struct
+import subprocess
+import sys
+import threading
+import time
+import urllib.request
+from pathlib import Path
+
+TOOLS = Path(__file__).absolute().parent
+HOST_NODE = str(TOOLS.joinpath('host_node', 'host_node'))
+SERVER = str(TOOLS.joinpath('client', 'telemetry_server'))
+
+sys.path.append(str(TOOLS.joinpath('client')))
+
+from client.log_types import (LOG_BLOCK_FILTERED, LOG_BLOCK_TYPES, filtered_fmt, filtered_names,
+                              log_block_data_control_loop_t, log_block_header_t, log_type_t)
+
+NODE_PORT = 9380
+HTTP_PORT = 9381
+RATE = 500
+
+# Must match vstp_cmd_t in include/vstp.h
+VSTP_CMD_LOG_START = 1
+VSTP_CMD_LOG_DATA = 3
+VSTP_CMD_LOG_FILTER = 9
+
+FIELDS = ('roll_error', 'pitch_error', 'raw_gyro_z')
+FIELD_MASK = sum(1 << log_block_data_control_loop_t.names.index(name) for name in FIELDS)
+
+
+def vstp_packet(cmd: int, payload: bytes = b'') -> bytes:
+    crc = cmd ^ len(payload)
+    for byte in payload:
+        crc ^= byte
+    return bytes([cmd, len(payload), crc]) + payload
+
+
+def feed_fc(uart, field_mask: int, stop: threading.Event) -> None:
+    ''' Sets the filter and streams control loop blocks into the node's UART, like the FC. '''
+    uart.write(vstp_packet(VSTP_CMD_LOG_START))
+    uart.write(vstp_packet(VSTP_CMD_LOG_FILTER, struct.pack('<Q', field_mask)))
+    t0 = time.monotonic()
+    i = 0
+    while not stop.is_set():
+        batch = b''
+        while i < (time.monotonic() - t0) * RATE:
+            block = log_block_data_control_loop_t(log_type_t.LOG_TYPE_PID, i, i, roll_error=i,
+                                                  pitch_error=-i, raw_gyro_z=2 * i, yaw_error=1)
+            batch += vstp_packet(VSTP_CMD_LOG_DATA, block.to_bytes())
+            i += 1
+        uart.write(batch)
+        uart.flush()
+        time.sleep(0.01)
+
+
+def recv_exact(sock: socket.socket, size: int) -> bytes:
+    data = b''
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            raise ConnectionError('Node closed the connection')
+        data += chunk
+    return data
+
+
+def read_node(n: int) -> list:
+    ''' Returns the first n blocks of the node, as (log type, dict of the fields it carried). '''
+    blocks = []
+    with socket.create_connection(('127.0.0.1', NODE_PORT), timeout=5) as sock:
+        while len(blocks) < n:
+            header = log_block_header_t(*struct.unpack(log_block_header_t.fmt, recv_exact(sock, log_block_header_t.size)))
+            block_type = LOG_BLOCK_TYPES[header.type]
+            data = struct.unpack(block_type.fmt, recv_exact(sock, block_type.size))
+            full_type = LOG_BLOCK_FILTERED.get(header.type)
+            if full_type is not None:
+                fmt = filtered_fmt(full_type, data[0])
+                values = struct.unpack(fmt, recv_exact(sock, struct.calcsize(fmt)))
+                blocks.append((header.type, dict(zip(filtered_names(full_type, data[0]), values))))
+            else:
+                blocks.append((header.type, dict(zip(block_type.names, data))))
+    return blocks
+
+
+def run_node(field_mask: int, check) -> bool:
+    node = subprocess.Popen([HOST_NODE, '-p', str(NODE_PORT)], stdin=subprocess.PIPE, stderr=subprocess.DEVNULL)
+    stop = threading.Event()
+    feeder = threading.Thread(target=feed_fc, args=(node.stdin, field_mask, stop), daemon=True)
+    time.sleep(0.3)
+    feeder.start()
+    try:
+        return check()
+    finally:
+        stop.set()
+        node.kill()
+        feeder.join()
+
+
+def check_filtered() -> bool:
+    blocks = read_node(200)
+    types = {t for t, _ in blocks}
+    names = {tuple(sorted(fields)) for _, fields in blocks}
+    print(f'Filtered: types {types}, fields {names}')
+    if types != {log_type_t.LOG_TYPE_PID_FILTERED} or names != {tuple(sorted(FIELDS))}:
+        print('FAIL: expected control_loop_filtered blocks with only the filtered fields')
+        return False
+    if any((f['pitch_error'] != -f['roll_error']) or (f['raw_gyro_z'] != 2 * f['roll_error']) for _, f in blocks):
+        print('FAIL: filtered fields do not match the FC blocks')
+        return False
+    return True
+
+
+def check_unfiltered() -> bool:
+    blocks = read_node(200)
+    types = {t for t, _ in blocks}
+    print(f'Unfiltered: types {types}')
+    if types != {log_type_t.LOG_TYPE_PID}:
+        print('FAIL: an empty filter should send full control_loop blocks')
+        return False
+    return True
+
+
+def check_server() -> bool:
+    server = subprocess.Popen([SERVER, '-l', str(HTTP_PORT), f'127.0.0.1:{NODE_PORT}'], stdout=subprocess.DEVNULL)
+    time.sleep(2)
+    ok = True
+    try:
+        records = []
+        with urllib.request.urlopen(f'http://127.0.0.1:{HTTP_PORT}/api/stream?hz=0') as stream:
+            for line in stream:
+                if line.startswith(b'data: '):
+                    records.append(json.loads(line[6:]))
+                if len(records) >= 100:
+                    break
+        types = {r['type'] for r in records}
+        names = {tuple(sorted(r['data'])) for r in records}
+        print(f'Stream: types {types}, fields {names}')
+        if types != {'control_loop'} or names != {tuple(sorted(FIELDS))}:
+            print('FAIL: expected control_loop records with only the filtered fields')
+            ok = False
+
+        for field, present in (('roll_error', True), ('yaw_error', False)):
+            url = f'http://127.0.0.1:{HTTP_PORT}/api/range?field={field}&n=100'
+            with urllib.request.urlopen(url) as response:
+                res = json.load(response)
+            values = [v for p in res['points'] for v in p[1:4]]
+            print(f'Range {field}: block {res["block"]}, {len(res["points"])} points, nulls: {values.count(None)}')
+            if not res['points'] or (res['block'] != 'control_loop'):
+                print(f'FAIL: no control_loop points for {field}')
+                ok = False
+            elif present and (None in values):
+                print(f'FAIL: {field} is filtered, but has missing points')
+                ok = False
+            elif not present and any(v is not None for v in values):
+                print(f'FAIL: {field} is not filtered, but has values')
+                ok = False
+    finally:
+        server.kill()
+    return ok
+
+
+if __name__ == '__main__':
+    ok = True
+    ok &= run_node(FIELD_MASK, check_filtered)
+    ok &= run_node(0, check_unfiltered)
+    ok &= run_node(FIELD_MASK, check_server)
+
+    print('OK' if ok else 'FAILED')
+    sys.exit(0 if ok else 1)
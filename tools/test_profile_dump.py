@@ -0,0 +1,143 @@
+'''
+Dumps the main loop profile of a host_node built with VSTP_PROFILE while
+telemetry_server streams from it, i.e. while the node's one client is taken:
+ - tools/profile_dump.py --server gets every phase through the server,
+   which forwards the dump over its connection to the node
+ - a dashboard on /api/stream sees the profile_phase records, and keeps
+   getting control_loop records during and after the dump
+ - /api/command rejects unknown commands and nodes
+
+Builds its own host_node with -D VSTP_PROFILE, build the server first with
+`make -C tools/client`.
+'''
+import json
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import urllib.error
+import urllib.request
+from pathlib import Path
+
+TOOLS = Path(__file__).absolute().parent
+SERVER = str(TOOLS.joinpath('client', 'telemetry_server'))
+PROFILE_DUMP = str(TOOLS.joinpath('profile_dump.py'))
+
+sys.path.append(str(TOOLS.joinpath('client')))
+
+from client.log_types import log_block_data_control_loop_t, log_profile_phase_t, log_type_t
+
+NODE_PORT = 9375
+HTTP_PORT = 9376
+RATE = 1000
+
+# Must match vstp_cmd_t in include/vstp.h
+VSTP_CMD_LOG_START = 1
+VSTP_CMD_LOG_DATA = 3
+
+
+def vstp_packet(cmd: int, payload: bytes = b'') -> bytes:
+    crc = cmd ^ len(payload)
+    for byte in payload:
+        crc ^= byte
+    return bytes([cmd, len(payload), crc]) + payload
+
+
+def feed_fc(uart, stop: threading.Event) -> None:
+    ''' Streams control loop blocks into the node's UART, like the FC. '''
+    uart.write(vstp_packet(VSTP_CMD_LOG_START))
+    t0 = time.monotonic()
+    i = 0
+    while not stop.is_set():
+        batch = b''
+        while i < (time.monotonic() - t0) * RATE:
+            block = log_block_data_control_loop_t(log_type_t.LOG_TYPE_PID, i, i, roll_error=i % 100)
+            batch += vstp_packet(VSTP_CMD_LOG_DATA, block.to_bytes())
+            i += 1
+        uart.write(batch)
+        uart.flush()
+        time.sleep(0.01)
+
+
+def read_dashboard(records: list, stop: threading.Event) -> None:
+    ''' Collects (arrival time, type) of every streamed record. '''
+    with urllib.request.urlopen(f'http://127.0.0.1:{HTTP_PORT}/api/stream?hz=0') as stream:
+        for line in stream:
+            if line.startswith(b'data: '):
+                records.append((time.time(), json.loads(line[6:])['type']))
+            if stop.is_set():
+                break
+
+
+def command_status(query: str) -> int:
+    try:
+        with urllib.request.urlopen(f'http://127.0.0.1:{HTTP_PORT}/api/command?{query}') as response:
+            return response.status
+    except urllib.error.HTTPError as e:
+        return e.code
+
+
+if __name__ == '__main__':
+    ok = True
+
+    with tempfile.TemporaryDirectory() as tmp:
+        host_node = str(Path(tmp).joinpath('host_node'))
+        subprocess.run(['make', '-s', '-C', str(TOOLS.joinpath('host_node')), f'NODE_TARGET={host_node}',
+                        'NODE_VARIANT=-D VSTP_PROFILE'], check=True)
+
+        node = subprocess.Popen([host_node, '-p', str(NODE_PORT)], stdin=subprocess.PIPE, stderr=subprocess.DEVNULL)
+        time.sleep(0.3)
+        stop = threading.Event()
+        feeder = threading.Thread(target=feed_fc, args=(node.stdin, stop), daemon=True)
+        feeder.start()
+        server = subprocess.Popen([SERVER, '-l', str(HTTP_PORT), f'127.0.0.1:{NODE_PORT}'], stdout=subprocess.DEVNULL)
+        time.sleep(1.5)
+
+        records = []
+        dashboard = threading.Thread(target=read_dashboard, args=(records, stop), daemon=True)
+        try:
+            dashboard.start()
+            time.sleep(1)
+
+            t_dump = time.time()
+            dump = subprocess.run([sys.executable, PROFILE_DUMP, '--server', f'127.0.0.1:{HTTP_PORT}', '--reset'],
+                                  capture_output=True, text=True, timeout=30)
+            t_done = time.time()
+            print(dump.stdout)
+            if dump.returncode != 0:
+                print(f'FAIL: profile_dump.py --server exited with {dump.returncode}')
+                ok = False
+            for phase in log_profile_phase_t:
+                if phase.name.replace('LOG_PROFILE_PHASE_', '') not in dump.stdout:
+                    print(f'FAIL: no {phase.name} in the dump')
+                    ok = False
+
+            time.sleep(1)
+            for query, status in (('cmd=profile_dump', 200), ('cmd=log_start', 400), ('cmd=profile_dump&node=3', 400)):
+                got = command_status(query)
+                print(f'/api/command?{query}: {got}')
+                if got != status:
+                    print(f'FAIL: expected {status}')
+                    ok = False
+            time.sleep(0.5)
+        finally:
+            stop.set()
+            server.kill()
+            node.kill()
+
+        profile = [t for t, type in records if type == 'profile_phase']
+        during = [t for t, type in records if (type == 'control_loop') and (t_dump <= t <= t_done)]
+        after = [t for t, type in records if (type == 'control_loop') and (t > t_done)]
+        print(f'Dashboard: {len(profile)} profile_phase records, control_loop {len(during)} during '
+              f'and {len(after)} after the dump')
+        # Two dumps: profile_dump.py and the /api/command check
+        if len(profile) != 2 * len(log_profile_phase_t):
+            print('FAIL: the dashboard did not see both dumps')
+            ok = False
+        if not during or not after:
+            print('FAIL: the dump interrupted the stream')
+            ok = False
+
+    print('OK' if ok else 'FAILED')
+    sys.exit(0 if ok else 1)
@@ -0,0 +1,177 @@
+'''
+Checks the decimation pyramid of telemetry_server (GET /api/range):
+ - a 20 minute, 1 kHz recording is replayed with -R
+ - every query returns at most n points, in time order
+ - min/max of the points match the samples, so short spikes survive
+   decimation at every zoom level
+ - small ranges come from level 0, i.e. the raw samples
+ - every point counts the samples it merges, which add up to the samples
+   in the range
+ - the live server answers range queries of a node_mock stream, also over
+   a from/to range on the host clock of the stream, and counts the samples
+   of the buckets that are still filling up
+
+Build the server first with `make -C tools/client`.
+'''
+import json
+import math
+import random
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+import urllib.request
+from pathlib import Path
+
+TOOLS = Path(__file__).absolute().parent
+SERVER = str(TOOLS.joinpath('client', 'telemetry_server'))
+NODE_MOCK = str(TOOLS.joinpath('node_mock.py'))
+
+sys.path.append(str(TOOLS.joinpath('client')))
+
+from client.log_types import log_block_data_control_loop_t, log_block_header_t, log_type_t
+
+HTTP_PORT = 9395
+NODE_PORT = 9396
+RATE = 1000
+DURATION_S = 20 * 60
+SPIKES = 20
+
+
+def f32(value: float) -> float:
+    return struct.unpack('<f', struct.pack('<f', value))[0]
+
+
+def make_recording(path: str) -> list:
+    ''' Writes a recording of roll_error = sin(t) with spikes, returns the values. '''
+    template = bytearray(log_block_data_control_loop_t(log_type_t.LOG_TYPE_PID, 0, 0).to_bytes())
+    field = log_block_data_control_loop_t.names.index('roll_error')
+    offset = log_block_header_t.size + struct.calcsize('<' + log_block_data_control_loop_t.fmt[1:1 + field])
+
+    n = RATE * DURATION_S
+    values = [math.sin(i / RATE) for i in range(n)]
+    for i in random.sample(range(n), SPIKES):
+        values[i] = random.choice((-1, 1)) * random.uniform(5, 10)
+
+    with open(path, 'wb') as f:
+        for i, value in enumerate(values):
+            struct.pack_into('<II', template, 1, i, i)  # 1 ms per sample
+            struct.pack_into('<f', template, offset, value)
+            f.write(template)
+    return [f32(v) for v in values]
+
+
+def pyramid_stats() -> list:
+    with urllib.request.urlopen(f'http://127.0.0.1:{HTTP_PORT}/api/stats') as stats:
+        return json.load(stats)['pyramid']
+
+
+def query(**params) -> dict:
+    url = f'http://127.0.0.1:{HTTP_PORT}/api/range?' + '&'.join(f'{k}={v}' for k, v in params.items())
+    with urllib.request.urlopen(url) as response:
+        return json.load(response)
+
+
+def check_range(values: list, a: int, b: int, n: int) -> bool:
+    t0 = time.time()
+    res = query(field='roll_error', **{'from': a}, to=b, n=n)
+    dt = (time.time() - t0) * 1000
+    points = [[p[0]] + [f32(v) for v in p[1:]] for p in res['points']]
+    times = [p[0] for p in points]
+    ok = True
+
+    if len(points) > n:
+        print(f'FAIL: [{a}, {b}] n={n}: {len(points)} points')
+        ok = False
+    if times != sorted(times):
+        print(f'FAIL: [{a}, {b}]: points out of order')
+        ok = False
+
+    # Buckets may reach outside the range, but never miss a sample in it
+    lo = min(p[1] for p in points)
+    hi = max(p[2] for p in points)
+    if (lo > min(values[a:b + 1])) or (hi < max(values[a:b + 1])):
+        print(f'FAIL: [{a}, {b}]: min/max {lo}/{hi}, samples {min(values[a:b + 1])}/{max(values[a:b + 1])}')
+        ok = False
+    if (res['level'] == 0) and ([p[3] for p in points] != values[a:b + 1]):
+        print(f'FAIL: [{a}, {b}]: level 0 points are not the samples')
+        ok = False
+
+    # Buckets at the edges may hold samples outside the range, at most a
+    # bucket on each side
+    samples = sum(p[4] for p in points)
+    edges = sum(p[4] for p in points[:1] + points[-1:])
+    if not (b - a + 1 <= samples <= b - a + 1 + edges):
+        print(f'FAIL: [{a}, {b}]: points hold {samples} samples')
+        ok = False
+
+    print(f'[{a}, {b}] n={n}: level {res["level"]}, {len(points)} points, {dt:.1f} ms')
+    return ok
+
+
+if __name__ == '__main__':
+    ok = True
+
+    with tempfile.TemporaryDirectory() as tmp:
+        recording = str(Path(tmp).joinpath('flight.0.vstp'))
+        values = make_recording(recording)
+        print(f'Recorded {len(values)} samples')
+
+        server = subprocess.Popen([SERVER, '-l', str(HTTP_PORT), '-R', recording])
+        time.sleep(1)
+        try:
+            while True:
+                try:
+                    print(pyramid_stats())
+                    break
+                except OSError:
+                    time.sleep(0.5)
+
+            last = len(values) - 1
+            ok &= check_range(values, 0, last, 1000)
+            ok &= check_range(values, 0, last, 4096)
+            ok &= check_range(values, 0, 999, 1000)
+            for _ in range(20):
+                a = random.randint(0, last)
+                b = random.randint(a, min(last, a + random.choice((100, 10000, 1000000))))
+                ok &= check_range(values, a, b, random.choice((100, 1000, 2000)))
+        finally:
+            server.kill()
+
+    # Live
+    node = subprocess.Popen([sys.executable, NODE_MOCK, str(NODE_PORT), str(RATE)], stdout=subprocess.DEVNULL)
+    time.sleep(0.5)
+    server = subprocess.Popen([SERVER, '-l', str(HTTP_PORT), f'127.0.0.1:{NODE_PORT}'], stdout=subprocess.DEVNULL)
+    time.sleep(3)
+    try:
+        before = pyramid_stats()[0]['samples']
+        res = query(field='roll_error', n=100)
+        after = pyramid_stats()[0]['samples']
+        counts = [p[4] for p in res['points']]
+        print(f'Live: level {res["level"]}, {len(counts)} points, last {counts[-3:]} samples')
+        if not counts or len(counts) > 100:
+            print('FAIL: live query')
+            ok = False
+        # Nothing was evicted yet, so the points hold every sample, the newest
+        # ones in buckets that are still filling up
+        elif not (before <= sum(counts) <= after) or any(c > 2 ** res['level'] for c in counts):
+            print(f'FAIL: live points hold {sum(counts)} samples, the series {before} to {after}')
+            ok = False
+
+        # One second of the stream, on the host clock like its first/last
+        series = next(s for s in pyramid_stats() if s['block'] == res['block'])
+        a = series['first'] + 1000
+        b = a + 1000
+        res = query(field='roll_error', **{'from': a}, to=b, n=4096)
+        times = [p[0] for p in res['points']]
+        print(f'Live [{a}, {b}]: level {res["level"]}, {len(times)} points')
+        if not times or (times[0] < a - res['points'][0][4]) or (times[-1] > b) or (times[-1] < b - 100):
+            print(f'FAIL: live query [{a}, {b}]: points from {times[:1]} to {times[-1:]}')
+            ok = False
+    finally:
+        server.kill()
+        node.kill()
+
+    print('OK' if ok else 'FAILED')
+    sys.exit(0 if ok else 1)
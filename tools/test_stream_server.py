@@ -0,0 +1,128 @@
+'''
+Checks the HTTP side of telemetry_server against a node_mock stream:
+ - /api/stream?hz=N is limited to N records/s, also when other query keys
+   end in "hz", and hz=0 gets every record
+ - a client that stops reading is skipped once it has
+   STREAM_SERVER_MAX_PENDING unsent bytes, while the others keep up
+ - a request head of STREAM_SERVER_REQUEST_MAX bytes gets a 431
+
+Build the server first with `make -C tools/client`.
+'''
+import json
+import socket
+import subprocess
+import sys
+import time
+import urllib.request
+from pathlib import Path
+
+TOOLS = Path(__file__).absolute().parent
+SERVER = str(TOOLS.joinpath('client', 'telemetry_server'))
+NODE_MOCK = str(TOOLS.joinpath('node_mock.py'))
+
+HTTP_PORT = 9385
+NODE_PORT = 9386
+RATE = 2000
+
+# Must match tools/client/include/stream_server.h
+STREAM_SERVER_REQUEST_MAX = 4096
+STREAM_SERVER_MAX_PENDING = 256 * 1024
+
+
+def stats() -> dict:
+    with urllib.request.urlopen(f'http://127.0.0.1:{HTTP_PORT}/api/stats') as response:
+        return json.load(response)
+
+
+def count_records(query: str, seconds: float) -> float:
+    ''' Returns the records/s streamed with the query, after the first second. '''
+    n = 0
+    with urllib.request.urlopen(f'http://127.0.0.1:{HTTP_PORT}/api/stream?{query}') as stream:
+        t_start = time.time() + 1
+        t_end = t_start + seconds
+        for line in stream:
+            now = time.time()
+            if now > t_end:
+                break
+            if line.startswith(b'data: ') and (now >= t_start):
+                n += 1
+    return n / seconds
+
+
+def check_rate_limit() -> bool:
+    ok = True
+    for query, hz in (('hz=20', 20), ('maxhz=5&hz=20', 20), ('hz=20&xhz=5', 20), ('hz=0', RATE)):
+        rate = count_records(query, 3)
+        print(f'?{query}: {rate:.0f} records/s')
+        if not (0.8 * hz <= rate <= 1.2 * hz):
+            print(f'FAIL: expected {hz} records/s')
+            ok = False
+    return ok
+
+
+def check_slow_client() -> bool:
+    ''' A client that stops reading must not queue without bound, or hold back the others. '''
+    slow = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    slow.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4096)
+    slow.connect(('127.0.0.1', HTTP_PORT))
+    slow.sendall(b'GET /api/stream?hz=0 HTTP/1.1\r\nHost: test\r\n\r\n')
+    try:
+        fast = count_records('hz=0', 8)
+        clients = stats()['clients']
+    finally:
+        slow.close()
+
+    # The slow client is the one with the most pending bytes
+    slowest = max(clients, key=lambda c: c['pending'])
+    print(f'Slow client: {slowest}, fast client: {fast:.0f} records/s')
+    ok = True
+    if slowest['dropped'] == 0:
+        print('FAIL: the slow client was not skipped')
+        ok = False
+    # At most one tick of frames over the limit
+    if slowest['pending'] > 2 * STREAM_SERVER_MAX_PENDING:
+        print(f'FAIL: {slowest["pending"]} B pending for the slow client')
+        ok = False
+    if fast < 0.8 * RATE:
+        print('FAIL: the slow client held back the fast one')
+        ok = False
+    return ok
+
+
+def check_request_too_large() -> bool:
+    with socket.create_connection(('127.0.0.1', HTTP_PORT), timeout=5) as sock:
+        # Never ends the head with an empty line. Exactly the limit, since the
+        # server closes after the 431, and unread bytes would reset the connection.
+        head = b'GET /api/stats HTTP/1.1\r\nX-Padding: '
+        sock.sendall(head + b'a' * (STREAM_SERVER_REQUEST_MAX - len(head)))
+        response = b''
+        while True:
+            chunk = sock.recv(4096)
+            if not chunk:
+                break
+            response += chunk
+    status = response.split(b'\r\n', 1)[0].decode()
+    print(f'Oversized request: {status}')
+    if not status.startswith('HTTP/1.1 431'):
+        print('FAIL: expected 431 Request Header Fields Too Large')
+        return False
+    return True
+
+
+if __name__ == '__main__':
+    ok = True
+
+    node = subprocess.Popen([sys.executable, NODE_MOCK, str(NODE_PORT), str(RATE)], stdout=subprocess.DEVNULL)
+    time.sleep(0.5)
+    server = subprocess.Popen([SERVER, '-l', str(HTTP_PORT), f'127.0.0.1:{NODE_PORT}'], stdout=subprocess.DEVNULL)
+    time.sleep(1)
+    try:
+        ok &= check_rate_limit()
+        ok &= check_slow_client()
+        ok &= check_request_too_large()
+    finally:
+        server.kill()
+        node.kill()
+
+    print('OK' if ok else 'FAILED')
+    sys.exit(0 if ok else 1)